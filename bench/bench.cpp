@@ -0,0 +1,297 @@
+// Measures the cost of logging with each kind of log.
+//
+//     bench [records] [threads] [directory]
+//
+// records   Number of records each measurement emits; the default is 200000.
+// threads   Largest number of producer threads in the latency table; the default is the number of
+//           hardware threads.
+// directory Where the file throughput test writes its log; the default is /tmp.
+#include <qlog.hpp>
+#include <qlog/binary.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t n) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* const p = std::malloc(n ? n : 1);
+  if(!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+/**
+ * @brief Returns the nanoseconds between two points in time.
+ */
+static double nanoseconds(bench_clock::time_point from, bench_clock::time_point to) {
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from)
+                             .count());
+}
+
+/**
+ * @brief Stream buffer that passes everything on to a file and counts the bytes.
+ */
+class counting_buf : public std::streambuf {
+  public:
+    explicit counting_buf(char const* path) : _bytes(0) {
+      _file.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    }
+
+    bool is_open() const {
+      return _file.is_open();
+    }
+
+    unsigned long long bytes() const {
+      return _bytes;
+    }
+
+  protected:
+    std::streamsize xsputn(char const* s, std::streamsize n) override {
+      _bytes += static_cast<unsigned long long>(n);
+      return _file.sputn(s, n);
+    }
+
+    int_type overflow(int_type c) override {
+      if(traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+      }
+      ++_bytes;
+      return _file.sputc(traits_type::to_char_type(c));
+    }
+
+    int sync() override {
+      return _file.pubsync();
+    }
+
+  private:
+    std::filebuf _file;
+    unsigned long long _bytes;
+};
+
+/** @brief Kinds of log that are measured. */
+enum class mode { sync, async, binary, binary_async };
+
+static char const* name(mode m) {
+  switch(m) {
+    case mode::sync: return "sync";
+    case mode::async: return "async";
+    case mode::binary: return "binary";
+    case mode::binary_async: return "binary async";
+  }
+  return "";
+}
+
+static mode const modes[] = { mode::sync, mode::async, mode::binary, mode::binary_async };
+
+/**
+ * @brief Log of one of the kinds being measured, writing at qlog::info.
+ */
+class subject {
+  public:
+    subject(mode m, std::ostream& o) {
+      switch(m) {
+        case mode::sync: _text.reset(new qlog::logger(o, qlog::info)); break;
+        case mode::async: _text.reset(new qlog::logger(o, qlog::info, 4096)); break;
+        case mode::binary: _binary.reset(new qlog::binary_logger(o, qlog::info)); break;
+        case mode::binary_async:
+          _binary.reset(new qlog::binary_logger(o, qlog::info, 4096));
+          break;
+      }
+    }
+
+    /**
+     * @brief Emits a typical record.
+     */
+    void enabled(long const i) {
+      if(_text) {
+        QLOG_INFO(*_text) << "request " << i << " finished in " << 2.5 << " ms";
+      } else {
+        QLOG_BINARY(*_binary, qlog::info) << "request " << i << " finished in " << 2.5 << " ms";
+      }
+    }
+
+    /**
+     * @brief Emits a record that the log's verbosity filters out.
+     */
+    void filtered(long const i) {
+      if(_text) {
+        QLOG_DEBUG(*_text) << "request " << i << " finished in " << 2.5 << " ms";
+      } else {
+        QLOG_BINARY(*_binary, qlog::debug) << "request " << i << " finished in " << 2.5 << " ms";
+      }
+    }
+
+    void flush() {
+      if(_text) {
+        _text->flush();
+      } else {
+        _binary->flush();
+      }
+    }
+
+  private:
+    std::unique_ptr<qlog::logger> _text;
+    std::unique_ptr<qlog::binary_logger> _binary;
+};
+
+/**
+ * @brief Prints the cost of one enabled and one filtered record, and the allocations of each.
+ */
+static void single_thread(long records) {
+  std::printf("One thread, %ld records to /dev/null, filtered records %scounted\n", records,
+              QLOG_METRICS && QLOG_COUNT_FILTERED ? "" : "not ");
+  std::printf("%-14s %12s %12s %14s %14s\n", "mode", "enabled ns", "filtered ns", "allocs/enabled",
+              "allocs/filter");
+  for(mode m : modes) {
+    counting_buf buf("/dev/null");
+    std::ostream out(&buf);
+    subject log(m, out);
+    for(long i = 0; i < 1000; ++i) {
+      log.enabled(i);
+    }
+    log.flush();
+
+    unsigned long long const a0 = allocations.load();
+    bench_clock::time_point const t0 = bench_clock::now();
+    for(long i = 0; i < records; ++i) {
+      log.enabled(i);
+    }
+    bench_clock::time_point const t1 = bench_clock::now();
+    unsigned long long const a1 = allocations.load();
+    log.flush();
+
+    unsigned long long const a2 = allocations.load();
+    bench_clock::time_point const t2 = bench_clock::now();
+    for(long i = 0; i < records; ++i) {
+      log.filtered(i);
+    }
+    bench_clock::time_point const t3 = bench_clock::now();
+    unsigned long long const a3 = allocations.load();
+
+    double const n = static_cast<double>(records);
+    std::printf("%-14s %12.1f %12.1f %14.3f %14.3f\n", name(m), nanoseconds(t0, t1) / n,
+                nanoseconds(t2, t3) / n, static_cast<double>(a1 - a0) / n,
+                static_cast<double>(a3 - a2) / n);
+  }
+  std::printf("\n");
+}
+
+/**
+ * @brief Prints the distribution of the time one record takes with several producer threads.
+ */
+static void latency(long records, unsigned max_threads) {
+  std::printf("Latency of one enabled record in ns, %ld records per thread to /dev/null\n",
+              records);
+  std::printf("%-14s %8s %10s %10s %10s %10s\n", "mode", "threads", "p50", "p99", "p999", "max");
+  for(mode m : modes) {
+    for(unsigned t = 1;; t = std::min(t * 2, max_threads)) {
+      counting_buf buf("/dev/null");
+      std::ostream out(&buf);
+      subject log(m, out);
+      std::vector<std::vector<float>> samples(t);
+      std::vector<std::thread> threads;
+      for(unsigned j = 0; j < t; ++j) {
+        samples[j].resize(static_cast<std::size_t>(records));
+        threads.emplace_back([&log, &samples, j, records] {
+          std::vector<float>& s = samples[j];
+          for(long i = 0; i < records; ++i) {
+            bench_clock::time_point const t0 = bench_clock::now();
+            log.enabled(i);
+            bench_clock::time_point const t1 = bench_clock::now();
+            s[static_cast<std::size_t>(i)] = static_cast<float>(nanoseconds(t0, t1));
+          }
+          log.flush();
+        });
+      }
+      for(auto& thread : threads) {
+        thread.join();
+      }
+
+      std::vector<float> all;
+      for(auto const& s : samples) {
+        all.insert(all.end(), s.begin(), s.end());
+      }
+      std::sort(all.begin(), all.end());
+      auto const at = [&all](double q) {
+        return all[static_cast<std::size_t>(q * static_cast<double>(all.size() - 1))];
+      };
+      std::printf("%-14s %8u %10.0f %10.0f %10.0f %10.0f\n", name(m), t, at(0.5), at(0.99),
+                  at(0.999), all.back());
+      if(t == max_threads) {
+        break;
+      }
+    }
+  }
+  std::printf("\n");
+}
+
+/**
+ * @brief Returns the bytes per second written by one thread to @p path.
+ */
+static double throughput(mode m, char const* path, long records) {
+  counting_buf buf(path);
+  if(!buf.is_open()) {
+    return 0;
+  }
+  std::ostream out(&buf);
+  bench_clock::time_point const t0 = bench_clock::now();
+  {
+    subject log(m, out);
+    for(long i = 0; i < records; ++i) {
+      log.enabled(i);
+    }
+  }
+  out.flush();
+  bench_clock::time_point const t1 = bench_clock::now();
+  return static_cast<double>(buf.bytes()) / nanoseconds(t0, t1) * 1e9;
+}
+
+/**
+ * @brief Prints the bytes per second written to /dev/null and to a file.
+ */
+static void bandwidth(long records, std::string const& directory) {
+  std::string const path = directory + "/qlog-bench.log";
+  std::printf("Throughput of one thread in MB/s, %ld records, including the final flush\n",
+              records);
+  std::printf("%-14s %12s %12s\n", "mode", "/dev/null", "file");
+  for(mode m : modes) {
+    double const null = throughput(m, "/dev/null", records);
+    double const file = throughput(m, path.c_str(), records);
+    std::printf("%-14s %12.1f %12.1f\n", name(m), null / 1e6, file / 1e6);
+  }
+  std::remove(path.c_str());
+  std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+  long const records = argc > 1 ? std::atol(argv[1]) : 200000;
+  unsigned const hardware = std::thread::hardware_concurrency();
+  unsigned const threads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2]))
+                                    : (hardware ? hardware : 1);
+  std::string const directory = argc > 3 ? argv[3] : "/tmp";
+  if(records <= 0 || threads == 0) {
+    std::fprintf(stderr, "usage: bench [records] [threads] [directory]\n");
+    return 2;
+  }
+  single_thread(records);
+  latency(records, threads);
+  bandwidth(records, directory);
+  return 0;
+}
@@ -1,19 +1,186 @@
 /** @file qlog.hpp */
 
 #pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <vector>
-#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/** @brief Level of qlog::none. */
+#define QLOG_LEVEL_NONE 0
+
+/** @brief Level of qlog::fatal. */
+#define QLOG_LEVEL_FATAL 100
+
+/** @brief Level of qlog::error. */
+#define QLOG_LEVEL_ERROR 200
+
+/** @brief Level of qlog::warn. */
+#define QLOG_LEVEL_WARN 300
+
+/** @brief Level of qlog::info. */
+#define QLOG_LEVEL_INFO 400
+
+/** @brief Level of qlog::debug. */
+#define QLOG_LEVEL_DEBUG 500
+
+/** @brief Level of qlog::all. */
+#define QLOG_LEVEL_ALL 999
+
+/** @brief Level of a qlog::category that has no level set, and follows its log's verbosity. */
+#define QLOG_LEVEL_INHERIT (~0UL)
+
+/**
+ * @brief The least severe level that is compiled into the program.
+ *
+ * Statements written with the QLOG_AT() family of macros whose level is greater than this are
+ * removed by the compiler, and the values they would have inserted are never evaluated. Define it
+ * before including qlog.hpp, or on the compiler's command line, for example
+ * @c -DQLOG_MIN_LEVEL=QLOG_LEVEL_INFO to remove debug logging from a release build.
+ */
+#ifndef QLOG_MIN_LEVEL
+#define QLOG_MIN_LEVEL QLOG_LEVEL_ALL
+#endif
+
+/**
+ * @brief Largest number of bytes in the text of one record, including its newline.
+ *
+ * Each thread that logs keeps one buffer of this size. Define it before including qlog.hpp to
+ * change it.
+ */
+#ifndef QLOG_RECORD_SIZE
+#define QLOG_RECORD_SIZE 2048
+#endif
+
+/**
+ * @brief Largest number of structured fields in one record. See qlog::logger::kv().
+ *
+ * Define it before including qlog.hpp to change it.
+ */
+#ifndef QLOG_RECORD_FIELDS
+#define QLOG_RECORD_FIELDS 32
+#endif
+
+/**
+ * @brief Room for the precomputed @c " [<name>] " prefix of a severity, whose name can then be
+ *        up to four bytes shorter than this.
+ *
+ * Severities with longer names still work, but write their prefix in pieces. Define it before
+ * including qlog.hpp to change it.
+ */
+#ifndef QLOG_PREFIX_SIZE
+#define QLOG_PREFIX_SIZE 24
+#endif
+
+/**
+ * @brief Set to 0 to leave the record counters of qlog::logger::metrics() out of the program.
+ *
+ * Counting costs one relaxed atomic increment for each record that is written. The counters of
+ * sink writes are kept either way. Define it before including qlog.hpp, or on the compiler's
+ * command line.
+ */
+#ifndef QLOG_METRICS
+#define QLOG_METRICS 1
+#endif
+
+/**
+ * @brief Set to 1 to also count the records that the verbosity filters out.
+ *
+ * It is off by default because it turns the filtered path, otherwise a single relaxed load, into
+ * an atomic increment of a counter that threads may share. With it off the filtered counters of
+ * qlog::logger::metrics() stay 0. Define it before including qlog.hpp, or on the compiler's
+ * command line.
+ */
+#ifndef QLOG_COUNT_FILTERED
+#define QLOG_COUNT_FILTERED 0
+#endif
+
+/**
+ * @brief Number of copies of the record counters of a qlog::logger.
+ *
+ * Each thread increments the counters of one copy, chosen when it first counts a record, so
+ * threads seldom share a cache line. The copies are added up when they are read. Define it
+ * before including qlog.hpp to change it.
+ */
+#ifndef QLOG_METRIC_SHARDS
+#define QLOG_METRIC_SHARDS 16
+#endif
 
 /** @namespace qlog */
 namespace qlog {
 
+  /** @namespace qlog::detail */
+  namespace detail {
+    /** @brief List of indices, for expanding an array element by element. */
+    template<std::size_t... I>
+    struct indices { };
+
+    /** @brief Builds qlog::detail::indices<0, 1, ..., N - 1>. */
+    template<std::size_t N, std::size_t... I>
+    struct make_indices : make_indices<N - 1, N - 1, I...> { };
+
+    template<std::size_t... I>
+    struct make_indices<0, I...> : indices<I...> { };
+
+    /**
+     * @brief Returns the length of the string @p s at compile time.
+     */
+    constexpr std::size_t length(char const* s) {
+      return *s ? 1 + length(s + 1) : 0;
+    }
+
+    /**
+     * @brief Returns byte @p k of the string @p s, or @c NULL if @p s is shorter.
+     *
+     * It never reads past the terminator, which lets an optimizing compiler see that a name
+     * built at run time is not indexed out of bounds.
+     */
+    constexpr char char_at(char const* s, std::size_t k) {
+      return *s == '\0' ? '\0' : k == 0 ? *s : char_at(s + 1, k - 1);
+    }
+
+    /**
+     * @brief Returns byte @p i of the severity prefix @c " [<name>] " for the name @p n of
+     *        length @p size, or @c NULL past its end.
+     */
+    constexpr char prefix_at(char const* n, std::size_t size, std::size_t i) {
+      return i == 0 ? ' ' : i == 1 ? '[' : i < size + 2 ? char_at(n, i - 2)
+           : i == size + 2 ? ']' : i == size + 3 ? ' ' : '\0';
+    }
+  }
+
   /**
    * @brief Used to define log severity levels.
    *
    * Each log level has a name and a number. The number is used when comparing the current 
    * verbosity level with the severity level of a message. If the message being emitted is lower
    * than the verbosity level of the log, then it will not be visible.
+   *
+   * A severity is a literal type, so severities and comparisons between them can be evaluated at
+   * compile time, and the text written after the timestamp of each record is built when the
+   * severity is. Severities defined outside this file work the same way. For example:
+   *
+   *     constexpr qlog::severity_t notice(350, "NOTICE");
+   *     static_assert(qlog::warn < notice && notice < qlog::info, "notice is between the two");
    */
   struct severity_t {
     /**
@@ -26,182 +193,3746 @@ namespace qlog {
      */
     char const* name;
 
+    /**
+     * @brief Default sampling rate: QLOG_SAMPLE() keeps one record in this many from each call
+     *        site. The predefined severities keep every record.
+     */
+    unsigned long sample;
+
+    /**
+     * @brief Length of the name.
+     */
+    std::size_t name_size;
+
+    /**
+     * @brief Length of qlog::severity_t::prefix, or 0 if the name is too long for it.
+     */
+    std::size_t prefix_size;
+
+    /**
+     * @brief Text written after the timestamp of each record: @c " [<name>] ".
+     */
+    char prefix[QLOG_PREFIX_SIZE];
+
     /**
      * @brief Initializes a new qlog::severity_t instance with a level and name.
      * @param[in] l Level of the new severity.
-     * @param[in] n Name of the new severity.
+     * @param[in] n Name of the new severity. It must outlive the severity.
+     * @param[in] s Default sampling rate of the new severity.
      */
-    severity_t(unsigned long l, char const* n) : level(l), name(n) { }
+    constexpr severity_t(unsigned long l, char const* n, unsigned long s = 1)
+      : severity_t(l, n, s, detail::length(n), detail::make_indices<QLOG_PREFIX_SIZE>()) {
+    }
+
+    private:
+      /**
+       * @brief Initializes the severity and its prefix, one element of @c I per byte.
+       */
+      template<std::size_t... I>
+      constexpr severity_t(unsigned long l, char const* n, unsigned long s, std::size_t size,
+                           detail::indices<I...>)
+        : level(l), name(n), sample(s), name_size(size),
+          prefix_size(size + 4 <= QLOG_PREFIX_SIZE ? size + 4 : 0),
+          prefix{ detail::prefix_at(n, size, I)... } {
+      }
   };
 
+  /** @brief Returns @c true if @p a has a lower level, and so is more severe, than @p b. */
+  constexpr bool operator<(severity_t const& a, severity_t const& b) {
+    return a.level < b.level;
+  }
+
+  /** @brief Returns @c true if @p a has a higher level, and so is less severe, than @p b. */
+  constexpr bool operator>(severity_t const& a, severity_t const& b) {
+    return a.level > b.level;
+  }
+
+  /** @brief Returns @c true if the level of @p a is at most that of @p b. */
+  constexpr bool operator<=(severity_t const& a, severity_t const& b) {
+    return a.level <= b.level;
+  }
+
+  /** @brief Returns @c true if the level of @p a is at least that of @p b. */
+  constexpr bool operator>=(severity_t const& a, severity_t const& b) {
+    return a.level >= b.level;
+  }
+
+  /** @brief Returns @c true if @p a and @p b have the same level. */
+  constexpr bool operator==(severity_t const& a, severity_t const& b) {
+    return a.level == b.level;
+  }
+
+  /** @brief Returns @c true if @p a and @p b have different levels. */
+  constexpr bool operator!=(severity_t const& a, severity_t const& b) {
+    return a.level != b.level;
+  }
+
   /**
    * @brief The qlog::none severity is intended to be used when setting the verbosity of the log to
    *        prevent any messages from being emitted.
    */
-  const severity_t none (  0, "NONE");
+  constexpr severity_t none (QLOG_LEVEL_NONE, "NONE");
 
   /**
    * @brief The message is for a catastrophic event that caused the program to terminate
    *        unexpectedly.
    */
-  const severity_t fatal(100, "FATAL");
+  constexpr severity_t fatal(QLOG_LEVEL_FATAL, "FATAL");
 
   /**
    * @brief The message is for an unexpected event that did not cause the program to terminate,
    *        but should be investigated.
    */
-  const severity_t error(200, "ERROR");
+  constexpr severity_t error(QLOG_LEVEL_ERROR, "ERROR");
 
   /**
    * @brief The message is for an event that may have been expected, but is not desired.
    */
-  const severity_t warn (300, "WARN");
+  constexpr severity_t warn (QLOG_LEVEL_WARN, "WARN");
 
   /**
    * @brief The message is for informational purposes only.
    */
-  const severity_t info (400, "INFO");
+  constexpr severity_t info (QLOG_LEVEL_INFO, "INFO");
 
   /**
    * @brief The message is for debugging the program, and can otherwise be ignored.
    */
-  const severity_t debug(500, "DEBUG");
+  constexpr severity_t debug(QLOG_LEVEL_DEBUG, "DEBUG");
 
   /**
    * @brief The qlog::all severity is intended to be used when setting the verbosity of the log to
    *        include all messages, including custom severity levels that may be defined external
    *        to this module.
    */
-  const severity_t all  (999, "ALL");
+  constexpr severity_t all  (QLOG_LEVEL_ALL, "ALL");
 
   /**
-   * @brief Simple logging class.
+   * @brief Number of fractional digits in a timestamp.
    */
-  class logger {
+  enum class timestamp_precision {
+    /** @brief Three digits, for example @c 2014-06-01T12:34:56.789Z. This is the default. */
+    milliseconds,
+
+    /** @brief Six digits, for example @c 2014-06-01T12:34:56.789012Z. */
+    microseconds,
+
+    /** @brief Nine digits, for example @c 2014-06-01T12:34:56.789012345Z. */
+    nanoseconds
+  };
+
+  /**
+   * @brief Formats ISO 8601 timestamps without calling @c strftime for every record.
+   *
+   * The @c %Y-%m-%dT%H:%M:%S part of the last timestamp is kept and reused until the second
+   * changes, so most timestamps only need their fractional digits written. A cache is not
+   * thread-safe; qlog::logger keeps one per thread.
+   */
+  class timestamp_cache {
     public:
       /**
-       * @brief Initializes a new qlog::logger instance with a verbosity level.
+       * @brief Size of a buffer that can hold any timestamp, including the terminating @c NULL.
        */
-      logger(severity_t const& v) :
-          _output(&std::cerr), _severity(all.level), _verbosity(v.level) { }
+      static const std::size_t max_size = 31;
+
+      timestamp_cache() : _second(-1) { }
 
       /**
-       * @brief Initializes a new qlog::logger instance with an output stream and verbosity level.
-       * @param[in] o Stream to which logging output is sent.
-       * @param[in] v Default verbosity level of the log.
+       * @brief Writes the current time into a buffer.
+       * @param[out] b Buffer that receives the timestamp.
+       * @param[in] n Size of @p b, which should be at least qlog::timestamp_cache::max_size.
+       * @param[in] p Number of fractional digits.
+       * @returns the length of the timestamp, not counting the terminating @c NULL, or 0 if @p b
+       *          is too small.
        */
-      logger(std::ostream& o = std::cerr, severity_t const& v = all)
-        : _output(&o), _severity(all.level), _verbosity(v.level) {
+      std::size_t format(char* b, std::size_t n,
+                         timestamp_precision p = timestamp_precision::milliseconds) {
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+        return format(t, b, n, p);
       }
 
       /**
-       * @brief Destructor.
+       * @brief Writes a given time into a buffer.
+       * @param[in] t Time to format.
+       * @param[out] b Buffer that receives the timestamp.
+       * @param[in] n Size of @p b, which should be at least qlog::timestamp_cache::max_size.
+       * @param[in] p Number of fractional digits.
+       * @returns the length of the timestamp, not counting the terminating @c NULL, or 0 if @p b
+       *          is too small.
        */
-      ~logger() {
-        // Adds a newline and flushes the stream.
-        (*_output) << std::endl;
+      std::size_t format(struct timespec const& t, char* b, std::size_t n,
+                         timestamp_precision p = timestamp_precision::milliseconds) {
+        std::size_t const digits = p == timestamp_precision::milliseconds ? 3
+                                 : p == timestamp_precision::microseconds ? 6 : 9;
+        std::size_t const length = prefix_size + 1 + digits + 1;
+        if(n <= length) {
+          return 0;
+        }
+        if(t.tv_sec != _second) {
+          struct tm time_info;
+          gmtime_r(&t.tv_sec, &time_info);
+          strftime(_prefix, sizeof(_prefix), "%Y-%m-%dT%H:%M:%S", &time_info);
+          _second = t.tv_sec;
+        }
+        std::memcpy(b, _prefix, prefix_size);
+        b[prefix_size] = '.';
+
+        // Writes the leading digits of the nanoseconds from right to left.
+        unsigned long f = static_cast<unsigned long>(t.tv_nsec);
+        for(std::size_t i = digits; i < 9; ++i) {
+          f /= 10;
+        }
+        for(std::size_t i = digits; i > 0; --i) {
+          b[prefix_size + i] = static_cast<char>('0' + f % 10);
+          f /= 10;
+        }
+        b[length - 1] = 'Z';
+        b[length] = '\0';
+        return length;
+      }
+
+    private:
+      /** @brief Length of the @c %Y-%m-%dT%H:%M:%S part of a timestamp. */
+      static const std::size_t prefix_size = 19;
+
+      /** @brief Second that qlog::timestamp_cache::_prefix was formatted for. */
+      time_t _second;
+
+      /** @brief The @c %Y-%m-%dT%H:%M:%S part of the last timestamp. */
+      char _prefix[prefix_size + 1];
+  };
+
+  /**
+   * @brief Clock that a log reads the time of each record from.
+   *
+   * Every clock is shown as wall clock time. The monotonic clocks are read raw while the record is
+   * started, and are turned into wall clock time by adding the time elapsed since an anchor, a
+   * pair of readings of the raw clock and @c CLOCK_REALTIME taken the first time the clock is
+   * used. Their timestamps therefore never step backwards, but they do not follow later changes
+   * to the system's wall clock either.
+   */
+  enum class clock_policy {
+    /** @brief @c CLOCK_REALTIME, read for every record. This is the default. */
+    wall,
+
+    /**
+     * @brief @c CLOCK_MONOTONIC_COARSE, which is read without touching the hardware. Its
+     *        resolution is one scheduler tick, usually 1 to 4 milliseconds.
+     */
+    monotonic_coarse,
+
+    /**
+     * @brief The processor's time stamp counter, read with @c rdtsc. It is calibrated against
+     *        @c CLOCK_MONOTONIC for 10 milliseconds the first time it is used, and assumes a
+     *        constant rate counter that is synchronized across cores. On processors without one
+     *        it is @c CLOCK_MONOTONIC.
+     */
+    tsc
+  };
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Returns a reading of @p c in nanoseconds.
+     */
+    inline std::uint64_t clock_nanoseconds(clockid_t c) {
+      struct timespec t;
+      clock_gettime(c, &t);
+      return static_cast<std::uint64_t>(t.tv_sec) * 1000000000u +
+             static_cast<std::uint64_t>(t.tv_nsec);
+    }
+
+    /**
+     * @brief Returns the raw reading of clock @p p, in its own units.
+     */
+    inline std::uint64_t clock_ticks(clock_policy p) {
+      switch(p) {
+        case clock_policy::wall:
+          return clock_nanoseconds(CLOCK_REALTIME);
+        case clock_policy::monotonic_coarse:
+#ifdef CLOCK_MONOTONIC_COARSE
+          return clock_nanoseconds(CLOCK_MONOTONIC_COARSE);
+#else
+          return clock_nanoseconds(CLOCK_MONOTONIC);
+#endif
+        case clock_policy::tsc:
+#if defined(__x86_64__) || defined(__i386__)
+          return __rdtsc();
+#else
+          return clock_nanoseconds(CLOCK_MONOTONIC);
+#endif
       }
+      return 0;
+    }
 
+    /**
+     * @brief Turns raw readings of a clock into wall clock time.
+     */
+    struct clock_anchor {
       /**
-       * @brief Generates the timestamp and log level at the beginning of the line.
-       * @param[in] l Severity level of the entry.
-       *
-       * This is used to generate the timestamp and emit the severity level of the message that
-       * follows. For example:
-       *
-       *     auto log = qlog::logger;
-       *     log(qlog::debug) << "This is a debug message";
+       * @brief Returns the wall clock time of the raw reading @p raw.
        */
-      logger& operator()(severity_t const& l) {
-        set_severity(l);
-        if(_severity <= _verbosity) {
-          (*_output) << std::endl << timestamp() << " [" << l.name << "] ";
+      struct timespec at(std::uint64_t raw) const {
+        std::int64_t d = static_cast<std::int64_t>(raw - ticks);
+        if(scale != 1.0) {
+          d = static_cast<std::int64_t>(static_cast<double>(d) * scale);
         }
-        return *this;
+        std::int64_t s = seconds + d / 1000000000;
+        std::int64_t ns = static_cast<std::int64_t>(nanoseconds) + d % 1000000000;
+        if(ns < 0) {
+          ns += 1000000000;
+          --s;
+        } else if(ns >= 1000000000) {
+          ns -= 1000000000;
+          ++s;
+        }
+        struct timespec t;
+        t.tv_sec = static_cast<time_t>(s);
+        t.tv_nsec = static_cast<long>(ns);
+        return t;
+      }
+
+      /** @brief Raw reading of the clock taken together with the wall clock time below. */
+      std::uint64_t ticks;
+
+      /** @brief Seconds of the wall clock time at qlog::detail::clock_anchor::ticks. */
+      std::int64_t seconds;
+
+      /** @brief Nanoseconds of the wall clock time at qlog::detail::clock_anchor::ticks. */
+      std::uint32_t nanoseconds;
+
+      /** @brief Nanoseconds per raw tick. */
+      double scale;
+    };
+
+    /**
+     * @brief Reads clock @p p and the wall clock as close together as possible.
+     * @param[in] p Clock to read.
+     * @param[in] scale Nanoseconds per raw tick of @p p.
+     */
+    inline clock_anchor make_anchor(clock_policy p, double scale) {
+      clock_anchor a;
+      a.ticks = clock_ticks(p);
+      struct timespec t;
+      clock_gettime(CLOCK_REALTIME, &t);
+      a.seconds = static_cast<std::int64_t>(t.tv_sec);
+      a.nanoseconds = static_cast<std::uint32_t>(t.tv_nsec);
+      a.scale = scale;
+      return a;
+    }
+
+    /**
+     * @brief Measures the nanoseconds per tick of the time stamp counter.
+     */
+    inline double tsc_scale() {
+      std::uint64_t const t0 = clock_ticks(clock_policy::tsc);
+      std::uint64_t const n0 = clock_nanoseconds(CLOCK_MONOTONIC);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      std::uint64_t const t1 = clock_ticks(clock_policy::tsc);
+      std::uint64_t const n1 = clock_nanoseconds(CLOCK_MONOTONIC);
+      return t1 > t0 ? static_cast<double>(n1 - n0) / static_cast<double>(t1 - t0) : 1.0;
+    }
+
+    /**
+     * @brief Returns the anchor of clock @p p, taking it the first time it is asked for.
+     */
+    inline clock_anchor const& anchor(clock_policy p) {
+      static clock_anchor const wall = { 0, 0, 0, 1.0 };
+      switch(p) {
+        case clock_policy::wall:
+          return wall;
+        case clock_policy::monotonic_coarse: {
+          static clock_anchor const coarse = make_anchor(p, 1.0);
+          return coarse;
+        }
+        case clock_policy::tsc: {
+          static clock_anchor const tsc = make_anchor(p, tsc_scale());
+          return tsc;
+        }
+      }
+      return wall;
+    }
+
+    /**
+     * @brief Returns the current wall clock time as told by clock @p p.
+     */
+    inline struct timespec clock_time(clock_policy p) {
+      if(p == clock_policy::wall) {
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+        return t;
       }
+      return anchor(p).at(clock_ticks(p));
+    }
+  }
+
+  /**
+   * @brief Determines what an asynchronous qlog::logger does with a record when its queue is full.
+   */
+  enum class overflow_policy {
+    /** @brief The logging thread waits until the background writer makes room. */
+    block,
+
+    /** @brief The new record is discarded. */
+    drop_newest,
+
+    /** @brief The oldest queued record is discarded to make room for the new one. */
+    drop_oldest
+  };
+
+  /**
+   * @brief Determines when a qlog::logger hands the records it has gathered to its sink.
+   *
+   * Finished records are copied into one buffer and written with a single call to the sink, which
+   * for a file or stream is a single system call, when any of the conditions below holds. The
+   * buffer is also written when it is full and whenever the log is flushed or destroyed. For
+   * example, to write at most every 100 milliseconds, but at once for errors:
+   *
+   *     log.set_flush_policy(qlog::flush_policy(0, 1 << 20, std::chrono::milliseconds(100)));
+   *
+   * An asynchronous log whose policy has no interval also writes whenever its queue runs empty,
+   * which is what it does by default. A synchronous log only looks at the interval when a record
+   * is finished, so a quiet log may hold its last records until it is flushed.
+   */
+  struct flush_policy {
+    /**
+     * @brief Initializes a new qlog::flush_policy.
+     * @param[in] r Number of records after which the buffer is written, or 0 for no limit.
+     * @param[in] b Number of bytes after which the buffer is written. This is also the size of
+     *              the buffer.
+     * @param[in] i Age of the oldest record after which the buffer is written, or 0 for no limit.
+     * @param[in] l Records of this severity or more severe are written at once.
+     */
+    explicit flush_policy(std::size_t r = 1, std::size_t b = 64 * 1024,
+                          std::chrono::milliseconds i = std::chrono::milliseconds(0),
+                          severity_t const& l = error)
+      : records(r), bytes(b ? b : 1), interval(i), level(l.level) {
+    }
+
+    /** @brief Number of records after which the buffer is written, or 0 for no limit. */
+    std::size_t records;
+
+    /** @brief Number of bytes after which the buffer is written. */
+    std::size_t bytes;
+
+    /** @brief Age of the oldest record after which the buffer is written, or 0 for no limit. */
+    std::chrono::milliseconds interval;
+
+    /** @brief Records whose level is at or below this are written at once. */
+    unsigned long level;
+  };
+
+  /**
+   * @brief Destination of finished records.
+   *
+   * A qlog::logger hands each finished record to a sink. An asynchronous log does so from its
+   * background thread, so a sink may do slow work, such as rotating files, without stalling the
+   * threads that produce records. A sink is only ever called by one thread at a time.
+   */
+  class sink {
+    public:
+      virtual ~sink() { }
 
       /**
-       * @brief Insertion operator that accepts any constant value.
-       * @param[in] o Constant value to emit.
-       * @returns a reference to the @c logger object for chaining.
+       * @brief Writes one or more complete, newline terminated records.
+       * @param[in] d First byte to write.
+       * @param[in] n Number of bytes to write.
        */
-      template<typename T>
-      logger& operator<<(const T& o) {
-        if(_severity <= _verbosity) {
-          (*_output) << o;
-        }
-        return *this;
+      virtual void write(char const* d, std::size_t n) = 0;
+
+      /**
+       * @brief Writes bytes that must stay together, such as a compressed frame, which need not
+       *        end in a newline. Sinks that split their input, like qlog::rotating_file_sink,
+       *        keep the block whole. The default calls write().
+       * @param[in] d First byte to write.
+       * @param[in] n Number of bytes to write.
+       */
+      virtual void write_block(char const* d, std::size_t n) {
+        write(d, n);
       }
 
       /**
-       * @brief Insertion operator that accepts any object value.
-       * @param[in] o Value to emit.
-       * @returns a reference to the @c logger object for chaining.
+       * @brief Returns @c true if the sink takes each record on its own, with its level, through
+       *        write_record() instead of batches of records through write().
        */
-      template<typename T>
-      logger& operator<<(T& o) {
-        if(_severity <= _verbosity) {
-          std::cout << o;
-        }
-        return *this;
+      virtual bool per_record() const {
+        return false;
       }
 
       /**
-       * @brief Specialized insertion operator that accepts @c std::ostream manipulators.
-       * @param[in] p Pointer to the @c std::ostream manipulator function.
-       * @returns a reference to the @c logger object for chaining.
+       * @brief Writes one complete, newline terminated record. A log calls this rather than
+       *        write() whenever the level is known; the default calls write().
+       * @param[in] d First byte of the record.
+       * @param[in] n Number of bytes of the record.
+       * @param[in] level Level of the severity of the record.
        */
-      logger& operator<<(std::ostream& (*p)(std::ostream&)) {
-        p(*_output);
-        return *this;
+      virtual void write_record(char const* d, std::size_t n, unsigned long level) {
+        (void)level;
+        write(d, n);
       }
 
       /**
-       * @brief Sets the new logging level.
-       * @param[in] l The new logging level.
-       * @returns a reference to the @c logger object for chaining.
+       * @brief Pushes anything the sink has buffered towards its destination.
        */
-      logger& set_severity(const severity_t l) {
-        _severity = l.level;
-        return *this;
+      virtual void flush() { }
+  };
+
+  /**
+   * @brief Sink that writes records to a @c std::ostream.
+   */
+  class ostream_sink : public sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::ostream_sink.
+       * @param[in] o Stream that receives the records. It must outlive the sink.
+       */
+      explicit ostream_sink(std::ostream& o) : _output(&o) { }
+
+      void write(char const* d, std::size_t n) override {
+        _output->write(d, static_cast<std::streamsize>(n));
+      }
+
+      void flush() override {
+        _output->flush();
+      }
+
+    private:
+      /** @brief Stream that receives the records. */
+      std::ostream* _output;
+  };
+
+  /**
+   * @brief Fixed size buffer that holds the text of one record.
+   *
+   * It never allocates memory. Text that does not fit is cut off, and the record then ends with
+   * @c ... to show that it was truncated. The size is set by QLOG_RECORD_SIZE.
+   */
+  class record_buffer {
+    public:
+      /** @brief Largest number of bytes in a record, including its newline. */
+      static const std::size_t capacity = QLOG_RECORD_SIZE;
+
+      record_buffer() : _size(0), _truncated(false) { }
+
+      /** @brief Returns the first byte of the record. */
+      char const* data() const { return _data; }
+
+      /** @brief Returns the number of bytes in the record. */
+      std::size_t size() const { return _size; }
+
+      /** @brief Empties the buffer. */
+      void clear() {
+        _size = 0;
+        _truncated = false;
       }
 
       /**
-       * @brief Returns a timestamp.
-       * @returns A @c NULL terminated character array that contains a timestamp.
+       * @brief Appends as much of @p n bytes starting at @p s as there is room for.
+       *
+       * One byte is always kept free for the newline added by qlog::record_buffer::terminate().
        */
-      const std::string timestamp() {
-        // Retrieve the time with microsecond accuracy.
-        struct timeval t;
-        struct timezone tz;
-        gettimeofday(&t, &tz);
+      void append(char const* s, std::size_t n) {
+        std::size_t const room = capacity - 1 - _size;
+        if(n > room) {
+          n = room;
+          _truncated = true;
+        }
+        std::memcpy(_data + _size, s, n);
+        _size += n;
+      }
+
+      /** @brief Appends one character if there is room for it. */
+      void push_back(char c) {
+        if(_size < capacity - 1) {
+          _data[_size++] = c;
+        } else {
+          _truncated = true;
+        }
+      }
 
-        // Converts `t.tv_sec`, which is the time in seconds since the epoch to a `struct tm`
-        struct tm time_info;
-        gmtime_r(&t.tv_sec, &time_info);
+      /**
+       * @brief Returns where the next @p n bytes may be written in place, or @c nullptr if there
+       *        is no room for them. Call qlog::record_buffer::commit() once they are written.
+       */
+      char* reserve(std::size_t n) {
+        if(n > capacity - 1 - _size) {
+          _truncated = true;
+          return nullptr;
+        }
+        return _data + _size;
+      }
 
-        // Format as a string.
-        const size_t maxsize = 80;
-        char time_str[maxsize];
-        strftime(time_str, maxsize, "%Y-%m-%dT%H:%M:%S", &time_info);
+      /** @brief Adds @p n bytes written at qlog::record_buffer::reserve() to the record. */
+      void commit(std::size_t n) {
+        _size += n;
+      }
 
-        // Append the milliseconds and the `Z`
-        sprintf(time_str, "%s.%dZ", time_str, t.tv_usec / 1000);
+      /** @brief Shortens the record to @p n bytes. */
+      void resize(std::size_t n) {
+        if(n < _size) {
+          _size = n;
+        }
+      }
 
-        // Done.
-        return time_str;
+      /**
+       * @brief Ends the record with a newline, marking it with @c ... if it was truncated.
+       */
+      void terminate() {
+        if(_truncated) {
+          std::size_t const n = _size < 3 ? _size : 3;
+          std::memset(_data + _size - n, '.', n);
+        }
+        _data[_size++] = '\n';
       }
 
     private:
+      /** @brief Text of the record. */
+      char _data[capacity];
 
-      /** @brief Stream that receives log messages. */
-      std::ostream* _output;
+      /** @brief Number of bytes in the record. */
+      std::size_t _size;
 
-      /** @brief Current message severity level. */
-      unsigned long _severity;
+      /** @brief @c true if some text did not fit. */
+      bool _truncated;
+  };
 
-      /** @brief Current log verbosity level. */
-      unsigned long _verbosity;
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Writes the decimal digits of @p v, which need at most 20 bytes, to @p b.
+     * @returns the number of bytes written.
+     */
+    inline std::size_t format_decimal(char* b, unsigned long long v) {
+      static char const pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+      char t[20];
+      char* p = t + sizeof(t);
+      while(v >= 100) {
+        unsigned const i = static_cast<unsigned>(v % 100) * 2;
+        v /= 100;
+        *--p = pairs[i + 1];
+        *--p = pairs[i];
+      }
+      if(v >= 10) {
+        unsigned const i = static_cast<unsigned>(v) * 2;
+        *--p = pairs[i + 1];
+        *--p = pairs[i];
+      } else {
+        *--p = static_cast<char>('0' + v);
+      }
+      std::size_t const n = static_cast<std::size_t>(t + sizeof(t) - p);
+      std::memcpy(b, p, n);
+      return n;
+    }
+
+    /**
+     * @brief Writes @p v, which needs at most 20 bytes, in decimal to @p b.
+     * @returns the number of bytes written.
+     */
+    inline std::size_t format_decimal(char* b, long long v) {
+      if(v < 0) {
+        *b = '-';
+        return 1 + format_decimal(b + 1, 0ULL - static_cast<unsigned long long>(v));
+      }
+      return format_decimal(b, static_cast<unsigned long long>(v));
+    }
+
+    /**
+     * @brief Writes @p v, which needs at most 24 bytes, to @p b with the fewest significant
+     *        digits that read back as the same value.
+     * @returns the number of bytes written.
+     *
+     * A value that 15 significant digits represent exactly is printed without trailing zeros,
+     * such as @c 0.1; others take 16 or 17 digits. The decimal point is always @c . whatever
+     * the locale.
+     */
+    inline std::size_t format_double(char* b, double v) {
+      char t[32];
+      int n = 0;
+      for(int digits = 15; digits <= 17; ++digits) {
+        n = std::snprintf(t, sizeof(t), "%.*g", digits, v);
+        if(digits == 17 || v != v || std::strtod(t, nullptr) == v) {
+          break;
+        }
+      }
+      for(int i = 0; i < n; ++i) {
+        b[i] = t[i] == ',' ? '.' : t[i];
+      }
+      return static_cast<std::size_t>(n);
+    }
+
+    /**
+     * @brief Writes @p v as @c 0x followed by lower case hexadecimal digits, which need at most
+     *        18 bytes, to @p b.
+     * @returns the number of bytes written.
+     */
+    inline std::size_t format_pointer(char* b, void const* v) {
+      static char const digits[] = "0123456789abcdef";
+      std::uintptr_t x = reinterpret_cast<std::uintptr_t>(v);
+      char t[2 * sizeof(x)];
+      char* p = t + sizeof(t);
+      do {
+        *--p = digits[x & 0xf];
+        x >>= 4;
+      } while(x);
+      std::size_t const n = static_cast<std::size_t>(t + sizeof(t) - p);
+      b[0] = '0';
+      b[1] = 'x';
+      std::memcpy(b + 2, p, n);
+      return n + 2;
+    }
+
+    /**
+     * @brief Writes @p n bytes at @p d to the file descriptor @p fd with @c write(2), retrying
+     *        short and interrupted writes. It is async-signal-safe.
+     */
+    inline void write_fully(int fd, char const* d, std::size_t n) {
+      while(n > 0) {
+        ssize_t const w = ::write(fd, d, n);
+        if(w < 0 && errno == EINTR) {
+          continue;
+        }
+        if(w <= 0) {
+          return;
+        }
+        d += w;
+        n -= static_cast<std::size_t>(w);
+      }
+    }
+  }
+
+  /**
+   * @brief Typed value of a structured field of a record. See qlog::logger::kv().
+   */
+  struct field {
+    /** @brief Which member of qlog::field::value, or qlog::field::text, holds the value. */
+    enum class kind : unsigned char { boolean, integer, unsigned_integer, real, text };
+
+    /** @brief Name of the field. */
+    char const* key;
+
+    /** @brief Length of the name. */
+    std::size_t key_size;
+
+    /** @brief Type of the value. */
+    kind type;
+
+    /** @brief Value of a field that is not text. */
+    union {
+      bool boolean;
+      long long integer;
+      unsigned long long unsigned_integer;
+      double real;
+    } value;
+
+    /** @brief Value of a text field. */
+    char const* text;
+
+    /** @brief Length of the value of a text field. */
+    std::size_t text_size;
   };
-}
 
+  /**
+   * @brief Fixed size store of the structured fields of one record.
+   *
+   * Keys and text values are copied into the store, so they need not outlive the call that adds
+   * them. It never allocates memory; fields that do not fit are dropped. The number of fields is
+   * set by QLOG_RECORD_FIELDS and the room for their text by QLOG_RECORD_SIZE.
+   */
+  class record_fields {
+    public:
+      /** @brief Largest number of fields in a record. */
+      static const std::size_t capacity = QLOG_RECORD_FIELDS;
+
+      record_fields() : _count(0), _size(0) { }
+
+      record_fields(record_fields const&) = delete;
+      record_fields& operator=(record_fields const&) = delete;
+
+      /** @brief Returns the first field. */
+      field const* begin() const { return _fields; }
+
+      /** @brief Returns the end of the fields. */
+      field const* end() const { return _fields + _count; }
+
+      /** @brief Returns the number of fields. */
+      std::size_t size() const { return _count; }
+
+      /** @brief Removes every field. */
+      void clear() {
+        _count = 0;
+        _size = 0;
+      }
+
+      /**
+       * @brief Adds a field of type @p t whose value the caller fills in.
+       * @returns the new field, or @c nullptr if there is no room for it.
+       */
+      field* add(char const* key, std::size_t n, field::kind t) {
+        if(_count == capacity || n > sizeof(_text) - _size) {
+          return nullptr;
+        }
+        field& f = _fields[_count++];
+        f.key = store(key, n);
+        f.key_size = n;
+        f.type = t;
+        f.text = nullptr;
+        f.text_size = 0;
+        return &f;
+      }
+
+      /**
+       * @brief Adds a text field, cutting the text off if there is not room for all of it.
+       */
+      void add(char const* key, std::size_t n, char const* s, std::size_t m) {
+        if(field* f = add(key, n, field::kind::text)) {
+          if(m > sizeof(_text) - _size) {
+            m = sizeof(_text) - _size;
+          }
+          f->text = store(s, m);
+          f->text_size = m;
+        }
+      }
+
+    private:
+      /**
+       * @brief Copies @p n bytes, for which there must be room, into the store.
+       */
+      char const* store(char const* s, std::size_t n) {
+        char* const p = _text + _size;
+        std::memcpy(p, s, n);
+        _size += n;
+        return p;
+      }
+
+      /** @brief The fields. */
+      field _fields[capacity];
+
+      /** @brief Keys and text values of the fields. */
+      char _text[QLOG_RECORD_SIZE];
+
+      /** @brief Number of fields. */
+      std::size_t _count;
+
+      /** @brief Number of bytes used in qlog::record_fields::_text. */
+      std::size_t _size;
+  };
+
+  /**
+   * @brief Parts of a finished record, as handed to a qlog::encoder.
+   */
+  struct record_view {
+    /** @brief Timestamp of the record, which is empty if it was never started. */
+    char const* timestamp;
+
+    /** @brief Length of the timestamp. */
+    std::size_t timestamp_size;
+
+    /** @brief Name of the severity of the record. */
+    char const* severity;
+
+    /** @brief Length of the name of the severity. */
+    std::size_t severity_size;
+
+    /** @brief Name of the category of the record, or @c nullptr. See qlog::category. */
+    char const* category;
+
+    /** @brief Length of the name of the category. */
+    std::size_t category_size;
+
+    /** @brief Free text inserted into the record. */
+    char const* message;
+
+    /** @brief Length of the free text. */
+    std::size_t message_size;
+
+    /** @brief Structured fields of the record. */
+    record_fields const* fields;
+  };
+
+  /**
+   * @brief Turns the parts of a finished record into the bytes its log writes.
+   *
+   * An encoder writes straight into the record buffer that is queued or written, and must not add
+   * the final newline, which the log adds. A log with no encoder writes the text format that
+   * qlog::text_encoder also produces, without gathering the parts first.
+   */
+  class encoder {
+    public:
+      virtual ~encoder() { }
+
+      /**
+       * @brief Writes the record @p r to @p out.
+       */
+      virtual void encode(record_view const& r, record_buffer& out) const = 0;
+  };
+
+  namespace detail {
+    /**
+     * @brief How each byte is written by the encoders, in one table built once.
+     */
+    struct escape_table {
+      escape_table() {
+        for(unsigned c = 0; c < 256; ++c) {
+          code[c] = c < 0x20 ? 'u' : 0;
+          quote[c] = c <= ' ' || c == '=' || c == '"' || c == '\\' || c == 0x7f;
+        }
+        code[static_cast<unsigned char>('"')] = '"';
+        code[static_cast<unsigned char>('\\')] = '\\';
+        code[static_cast<unsigned char>('\b')] = 'b';
+        code[static_cast<unsigned char>('\f')] = 'f';
+        code[static_cast<unsigned char>('\n')] = 'n';
+        code[static_cast<unsigned char>('\r')] = 'r';
+        code[static_cast<unsigned char>('\t')] = 't';
+      }
+
+      /**
+       * @brief How a byte is written inside quotes: 0 as itself, @c u as @c \\u00XX, and
+       *        anything else as a backslash followed by the entry.
+       */
+      char code[256];
+
+      /** @brief @c true for the bytes that make a logfmt value need quotes. */
+      bool quote[256];
+    };
+
+    /**
+     * @brief Returns the escape table.
+     */
+    inline escape_table const& escapes() {
+      static escape_table const t;
+      return t;
+    }
+
+    /**
+     * @brief Appends @p n bytes at @p s to @p out in double quotes, with escapes.
+     */
+    inline void append_quoted(record_buffer& out, char const* s, std::size_t n) {
+      static char const hex[] = "0123456789abcdef";
+      escape_table const& t = escapes();
+      out.push_back('"');
+      std::size_t plain = 0;
+      for(std::size_t i = 0; i < n; ++i) {
+        unsigned char const c = static_cast<unsigned char>(s[i]);
+        if(t.code[c]) {
+          out.append(s + plain, i - plain);
+          plain = i + 1;
+          if(t.code[c] == 'u') {
+            char const e[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            out.append(e, sizeof(e));
+          } else {
+            char const e[] = { '\\', t.code[c] };
+            out.append(e, sizeof(e));
+          }
+        }
+      }
+      out.append(s + plain, n - plain);
+      out.push_back('"');
+    }
+
+    /**
+     * @brief Appends @p n bytes at @p s to @p out as a logfmt value, in quotes only if needed.
+     */
+    inline void append_bare(record_buffer& out, char const* s, std::size_t n) {
+      escape_table const& t = escapes();
+      for(std::size_t i = 0; i < n; ++i) {
+        if(t.quote[static_cast<unsigned char>(s[i])]) {
+          append_quoted(out, s, n);
+          return;
+        }
+      }
+      if(n == 0) {
+        out.append("\"\"", 2);
+      } else {
+        out.append(s, n);
+      }
+    }
+
+    /**
+     * @brief Appends the value of @p f to @p out, with text in JSON quotes if @p json is
+     *        @c true, and as a logfmt value otherwise.
+     */
+    inline void append_value(record_buffer& out, field const& f, bool json) {
+      switch(f.type) {
+        case field::kind::boolean:
+          f.value.boolean ? out.append("true", 4) : out.append("false", 5);
+          break;
+        case field::kind::integer:
+          if(char* b = out.reserve(20)) {
+            out.commit(format_decimal(b, f.value.integer));
+          }
+          break;
+        case field::kind::unsigned_integer:
+          if(char* b = out.reserve(20)) {
+            out.commit(format_decimal(b, f.value.unsigned_integer));
+          }
+          break;
+        case field::kind::real:
+          if(json && (f.value.real != f.value.real || f.value.real - f.value.real != 0)) {
+            out.append("null", 4);
+          } else if(char* b = out.reserve(24)) {
+            out.commit(format_double(b, f.value.real));
+          }
+          break;
+        case field::kind::text:
+          json ? append_quoted(out, f.text, f.text_size) : append_bare(out, f.text, f.text_size);
+          break;
+      }
+    }
+
+    /**
+     * @brief Appends each field of @p fields to @p out as @c " key=value".
+     */
+    inline void append_logfmt(record_buffer& out, record_fields const& fields) {
+      for(field const& f : fields) {
+        out.push_back(' ');
+        out.append(f.key, f.key_size);
+        out.push_back('=');
+        append_value(out, f, false);
+      }
+    }
+  }
+
+  /**
+   * @brief Encoder of the default text format:
+   *        @c "<timestamp> [<severity>] [<category>] <message> key=value ...".
+   */
+  class text_encoder : public encoder {
+    public:
+      void encode(record_view const& r, record_buffer& out) const override {
+        if(r.timestamp_size) {
+          out.append(r.timestamp, r.timestamp_size);
+          out.append(" [", 2);
+          out.append(r.severity, r.severity_size);
+          out.append("] ", 2);
+          if(r.category) {
+            out.push_back('[');
+            out.append(r.category, r.category_size);
+            out.append("] ", 2);
+          }
+        }
+        out.append(r.message, r.message_size);
+        detail::append_logfmt(out, *r.fields);
+      }
+  };
+
+  /**
+   * @brief Encoder of JSON lines, one object per record. For example:
+   *
+   *     {"time":"2014-06-01T12:34:56.789Z","level":"INFO","message":"done","latency_us":12}
+   *
+   * A record that does not fit in QLOG_RECORD_SIZE bytes is cut off and is no longer valid JSON.
+   */
+  class json_encoder : public encoder {
+    public:
+      void encode(record_view const& r, record_buffer& out) const override {
+        out.push_back('{');
+        if(r.timestamp_size) {
+          out.append("\"time\":\"", 8);
+          out.append(r.timestamp, r.timestamp_size);
+          out.append("\",", 2);
+        }
+        out.append("\"level\":", 8);
+        detail::append_quoted(out, r.severity, r.severity_size);
+        if(r.category) {
+          out.append(",\"category\":", 12);
+          detail::append_quoted(out, r.category, r.category_size);
+        }
+        out.append(",\"message\":", 11);
+        detail::append_quoted(out, r.message, r.message_size);
+        for(field const& f : *r.fields) {
+          out.push_back(',');
+          detail::append_quoted(out, f.key, f.key_size);
+          out.push_back(':');
+          detail::append_value(out, f, true);
+        }
+        out.push_back('}');
+      }
+  };
+
+  /**
+   * @brief Encoder of logfmt lines. For example:
+   *
+   *     time=2014-06-01T12:34:56.789Z level=INFO msg=done latency_us=12
+   */
+  class logfmt_encoder : public encoder {
+    public:
+      void encode(record_view const& r, record_buffer& out) const override {
+        if(r.timestamp_size) {
+          out.append("time=", 5);
+          out.append(r.timestamp, r.timestamp_size);
+          out.push_back(' ');
+        }
+        out.append("level=", 6);
+        detail::append_bare(out, r.severity, r.severity_size);
+        if(r.category) {
+          out.append(" category=", 10);
+          detail::append_bare(out, r.category, r.category_size);
+        }
+        out.append(" msg=", 5);
+        detail::append_bare(out, r.message, r.message_size);
+        detail::append_logfmt(out, *r.fields);
+      }
+  };
+
+  /**
+   * @brief Counters of a qlog::logger, as returned by qlog::logger::metrics().
+   *
+   * Records are counted under the least severe predefined severity that is at least as severe as
+   * theirs, so a custom level between qlog::warn and qlog::info counts as qlog::info, and one
+   * below qlog::debug counts as @c other. Every counter only grows, except
+   * qlog::log_metrics::queue_high_water. See qlog/metrics.hpp for a Prometheus exporter.
+   */
+  struct log_metrics {
+    /** @brief Number of severity slots: fatal, error, warn, info, debug and other. */
+    static const std::size_t levels = 6;
+
+    /** @brief Number of buckets of the sink write latency histogram. */
+    static const std::size_t buckets = 20;
+
+    log_metrics()
+      : bytes(0), dropped(0), suppressed(0), queue_high_water(0), writes(0), write_nanoseconds(0) {
+      for(std::size_t i = 0; i < levels; ++i) {
+        emitted[i] = 0;
+        filtered[i] = 0;
+      }
+      for(std::size_t i = 0; i < buckets; ++i) {
+        latency[i] = 0;
+      }
+    }
+
+    /**
+     * @brief Returns the slot that records of level @p level are counted under.
+     */
+    static std::size_t slot(unsigned long level) {
+      return level <= QLOG_LEVEL_FATAL ? 0 : level <= QLOG_LEVEL_ERROR ? 1
+           : level <= QLOG_LEVEL_WARN ? 2 : level <= QLOG_LEVEL_INFO ? 3
+           : level <= QLOG_LEVEL_DEBUG ? 4 : 5;
+    }
+
+    /**
+     * @brief Returns the lower case name of slot @p i.
+     */
+    static char const* slot_name(std::size_t i) {
+      static char const* const names[levels] = {
+        "fatal", "error", "warn", "info", "debug", "other"
+      };
+      return i < levels ? names[i] : "";
+    }
+
+    /**
+     * @brief Returns the longest write, in nanoseconds, that bucket @p i counts: 1 microsecond
+     *        for the first bucket, doubling with each bucket. The last bucket has no bound.
+     */
+    static unsigned long long bucket_bound(std::size_t i) {
+      return i + 1 < buckets ? 1000ULL << i : ~0ULL;
+    }
+
+    /** @brief Number of records finished, by severity slot. */
+    unsigned long long emitted[levels];
+
+    /** @brief Number of records turned away by the verbosity filter, by severity slot. */
+    unsigned long long filtered[levels];
+
+    /** @brief Number of bytes of the finished records, counted once however many sinks get them. */
+    unsigned long long bytes;
+
+    /** @brief Number of records discarded because a queue was full, summed over the sinks. */
+    unsigned long long dropped;
+
+    /** @brief Number of records suppressed by a qlog::rate_limit. */
+    unsigned long long suppressed;
+
+    /** @brief Most records that ever waited at once in the queue of one sink. */
+    std::size_t queue_high_water;
+
+    /** @brief Number of writes to the sinks that fell into each bucket; see bucket_bound(). */
+    unsigned long long latency[buckets];
+
+    /** @brief Number of writes to the sinks. */
+    unsigned long long writes;
+
+    /** @brief Total nanoseconds spent in writes to the sinks. */
+    unsigned long long write_nanoseconds;
+  };
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Histogram of how long the writes to one sink take.
+     */
+    class latency_histogram {
+      public:
+        latency_histogram() : _writes(0), _nanoseconds(0) {
+          for(std::size_t i = 0; i < log_metrics::buckets; ++i) {
+            _counts[i].store(0, std::memory_order_relaxed);
+          }
+        }
+
+        /**
+         * @brief Counts one write that took @p d.
+         */
+        void add(std::chrono::steady_clock::duration d) {
+          unsigned long long const ns = static_cast<unsigned long long>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+          std::size_t i = 0;
+          while(ns > log_metrics::bucket_bound(i)) {
+            ++i;
+          }
+          _counts[i].fetch_add(1, std::memory_order_relaxed);
+          _writes.fetch_add(1, std::memory_order_relaxed);
+          _nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Adds the counts to @p m.
+         */
+        void add_to(log_metrics& m) const {
+          for(std::size_t i = 0; i < log_metrics::buckets; ++i) {
+            m.latency[i] += _counts[i].load(std::memory_order_relaxed);
+          }
+          m.writes += _writes.load(std::memory_order_relaxed);
+          m.write_nanoseconds += _nanoseconds.load(std::memory_order_relaxed);
+        }
+
+      private:
+        /** @brief Number of writes in each bucket. */
+        std::atomic<unsigned long long> _counts[log_metrics::buckets];
+
+        /** @brief Number of writes. */
+        std::atomic<unsigned long long> _writes;
+
+        /** @brief Total nanoseconds of the writes. */
+        std::atomic<unsigned long long> _nanoseconds;
+    };
+
+    /**
+     * @brief One copy of the record counters of a qlog::logger.
+     */
+    struct metric_shard {
+      metric_shard() : bytes(0), suppressed(0) {
+        for(std::size_t i = 0; i < log_metrics::levels; ++i) {
+          emitted[i].store(0, std::memory_order_relaxed);
+          filtered[i].store(0, std::memory_order_relaxed);
+        }
+      }
+
+      /** @brief Number of records finished, by severity slot. */
+      std::atomic<unsigned long long> emitted[log_metrics::levels];
+
+      /** @brief Number of records filtered out, by severity slot. */
+      std::atomic<unsigned long long> filtered[log_metrics::levels];
+
+      /** @brief Number of bytes of the finished records. */
+      std::atomic<unsigned long long> bytes;
+
+      /** @brief Number of records suppressed by a qlog::rate_limit. */
+      std::atomic<unsigned long long> suppressed;
+
+      /** @brief Keeps the next copy off the cache line of these counters. */
+      char pad[64];
+    };
+
+    /**
+     * @brief Returns the index of the calling thread's copy of the record counters.
+     */
+    inline std::size_t metric_shard_index() {
+      static std::atomic<std::size_t> next(0);
+      static thread_local std::size_t const i =
+        next.fetch_add(1, std::memory_order_relaxed) % QLOG_METRIC_SHARDS;
+      return i;
+    }
+  }
+
+  /**
+   * @brief Finished records gathered for a single write to a sink, under a qlog::flush_policy.
+   *
+   * A batch is used by one thread at a time: the background writer of an asynchronous log, or
+   * the holder of a synchronous log's lock. Its buffer is allocated when the first record arrives.
+   * A sink whose qlog::sink::per_record() is @c true is handed each record with its level as it
+   * arrives instead, and the policy only decides when that sink is flushed.
+   */
+  class record_batch {
+    public:
+      /**
+       * @brief Initializes a new, empty qlog::record_batch.
+       * @param[in] p When the gathered records are written.
+       */
+      explicit record_batch(flush_policy const& p = flush_policy())
+        : _policy(p), _handed(0), _records(0) { }
+
+      /**
+       * @brief Returns the policy that decides when the gathered records are written.
+       */
+      flush_policy const& policy() const {
+        return _policy;
+      }
+
+      /**
+       * @brief Replaces the policy. Records already gathered are kept.
+       */
+      void set_policy(flush_policy const& p) {
+        _policy = p;
+      }
+
+      /**
+       * @brief Returns @c true if no record is waiting to be written.
+       */
+      bool empty() const {
+        return _records == 0;
+      }
+
+      /**
+       * @brief Returns the time by which the gathered records must be written under the policy's
+       *        interval.
+       */
+      std::chrono::steady_clock::time_point deadline() const {
+        return _first + _policy.interval;
+      }
+
+      /**
+       * @brief Returns @c true if the oldest gathered record has waited for the policy's interval.
+       */
+      bool expired() const {
+        return _records && _policy.interval.count() > 0 &&
+               std::chrono::steady_clock::now() >= deadline();
+      }
+
+      /**
+       * @brief Gathers a record and writes the batch if the policy says it is due.
+       * @param[in] d First byte of the record.
+       * @param[in] n Length of the record.
+       * @param[in] level Level of the severity of the record.
+       * @param[in] s Sink to which the batch is written.
+       * @returns the number of records written to @p s.
+       */
+      std::size_t add(char const* d, std::size_t n, unsigned long level, sink& s) {
+        std::size_t written = 0;
+        std::size_t const size = _data.size() + _handed;
+        if(_records && size + n > _policy.bytes) {
+          written = write(s);
+        }
+        if(!_records && _policy.interval.count() > 0) {
+          _first = std::chrono::steady_clock::now();
+        }
+        if(s.per_record()) {
+          // The sink gathers the records itself; the batch only decides when it is flushed.
+          s.write_record(d, n, level);
+          _handed += n;
+        } else {
+          if(_data.capacity() < _policy.bytes) {
+            _data.reserve(_policy.bytes);
+          }
+          _data.append(d, n);
+        }
+        ++_records;
+        if(level <= _policy.level || _data.size() + _handed >= _policy.bytes ||
+           (_policy.records && _records >= _policy.records) || expired()) {
+          written += write(s);
+        }
+        return written;
+      }
+
+      /**
+       * @brief Writes the gathered records, if any, with one call to @p s and flushes it, which
+       *        for a sink that takes records one at a time is all that is left to do.
+       * @returns the number of records written.
+       */
+      std::size_t write(sink& s) {
+        std::size_t const n = _records;
+        if(!n) {
+          s.flush();
+          return 0;
+        }
+        std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+        if(!_data.empty()) {
+          s.write(_data.data(), _data.size());
+        }
+        _data.clear();
+        _handed = 0;
+        _records = 0;
+        s.flush();
+        _latency.add(std::chrono::steady_clock::now() - start);
+        return n;
+      }
+
+      /**
+       * @brief Returns the histogram of how long writing the batch to its sink took.
+       */
+      detail::latency_histogram const& latency() const {
+        return _latency;
+      }
+
+      /**
+       * @brief Writes the gathered records to the file descriptor @p fd without taking them out
+       *        of the batch. It is async-signal-safe; see qlog::logger::salvage().
+       */
+      void salvage(int fd) const {
+        detail::write_fully(fd, _data.data(), _data.size());
+      }
+
+    private:
+      /** @brief When the gathered records are written. */
+      flush_policy _policy;
+
+      /** @brief Text of the gathered records. */
+      std::string _data;
+
+      /**
+       * @brief Bytes of the gathered records that were handed straight to a sink that takes
+       *        records one at a time.
+       */
+      std::size_t _handed;
+
+      /** @brief Number of gathered records. */
+      std::size_t _records;
+
+      /** @brief When the oldest gathered record arrived, if the policy has an interval. */
+      std::chrono::steady_clock::time_point _first;
+
+      /** @brief How long the writes of the batch took. */
+      detail::latency_histogram _latency;
+  };
+
+  /**
+   * @brief Bounded, lock-free queue of finished records.
+   *
+   * This is a ring of cells, each with a sequence number that tells producers and consumers
+   * whether the cell is free or holds a record. Any number of threads may push records at once
+   * without taking a lock. The background writer is the only thread that normally pops records;
+   * a producer also pops one when it discards the oldest record to make room, which the
+   * algorithm allows.
+   *
+   * A producer copies its record into the string of a cell, and the consumer swaps that string
+   * out, so the storage of a record that has been written goes back into the ring. Each cell
+   * reserves room for QLOG_RECORD_SIZE bytes up front, so pushing a text record never allocates.
+   */
+  class record_ring {
+    public:
+      /**
+       * @brief Initializes a new qlog::record_ring.
+       * @param[in] c Minimum number of records the ring can hold. It is rounded up to a power of
+       *              two.
+       */
+      explicit record_ring(std::size_t c) : _cells(capacity_for(c)), _mask(_cells.size() - 1),
+          _head(0), _tail(0) {
+        for(std::size_t i = 0; i < _cells.size(); ++i) {
+          _cells[i].sequence.store(i, std::memory_order_relaxed);
+          _cells[i].record.reserve(QLOG_RECORD_SIZE);
+        }
+      }
+
+      record_ring(record_ring const&) = delete;
+      record_ring& operator=(record_ring const&) = delete;
+
+      /**
+       * @brief Adds a record to the ring if there is room for it.
+       * @param[in] d First byte of the record.
+       * @param[in] n Length of the record.
+       * @param[in] level Level of the severity of the record.
+       * @returns @c false if the ring is full.
+       */
+      bool try_push(char const* d, std::size_t n, unsigned long level) {
+        std::size_t pos = _tail.load(std::memory_order_relaxed);
+        for(;;) {
+          cell& c = _cells[pos & _mask];
+          std::size_t const seq = c.sequence.load(std::memory_order_acquire);
+          std::ptrdiff_t const diff = static_cast<std::ptrdiff_t>(seq - pos);
+          if(diff == 0) {
+            if(_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              c.record.assign(d, n);
+              c.level = level;
+              c.sequence.store(pos + 1, std::memory_order_release);
+              return true;
+            }
+          } else if(diff < 0) {
+            return false;
+          } else {
+            pos = _tail.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      /**
+       * @brief Removes the oldest record from the ring.
+       * @param[in,out] r Receives the record. Its previous contents are cleared and its storage
+       *                  is left in the ring for a later producer, so it should have room for
+       *                  QLOG_RECORD_SIZE bytes.
+       * @param[out] level Receives the level of the severity of the record.
+       * @returns @c false if the ring is empty.
+       */
+      bool try_pop(std::string& r, unsigned long& level) {
+        std::size_t pos = _head.load(std::memory_order_relaxed);
+        for(;;) {
+          cell& c = _cells[pos & _mask];
+          std::size_t const seq = c.sequence.load(std::memory_order_acquire);
+          std::ptrdiff_t const diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+          if(diff == 0) {
+            if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              r.clear();
+              c.record.swap(r);
+              level = c.level;
+              c.sequence.store(pos + _mask + 1, std::memory_order_release);
+              return true;
+            }
+          } else if(diff < 0) {
+            return false;
+          } else {
+            pos = _head.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      /**
+       * @brief Removes the oldest record from the ring and throws it away.
+       *
+       * Unlike qlog::record_ring::try_pop(), the record's storage stays in its cell, so making
+       * room in a full ring does not allocate.
+       *
+       * @returns @c false if the ring is empty.
+       */
+      bool try_discard() {
+        std::size_t pos = _head.load(std::memory_order_relaxed);
+        for(;;) {
+          cell& c = _cells[pos & _mask];
+          std::size_t const seq = c.sequence.load(std::memory_order_acquire);
+          std::ptrdiff_t const diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+          if(diff == 0) {
+            if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              c.record.clear();
+              c.sequence.store(pos + _mask + 1, std::memory_order_release);
+              return true;
+            }
+          } else if(diff < 0) {
+            return false;
+          } else {
+            pos = _head.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      /**
+       * @brief Returns @c true if no record is waiting in the ring.
+       */
+      bool empty() const {
+        std::size_t const pos = _head.load(std::memory_order_relaxed);
+        return _cells[pos & _mask].sequence.load(std::memory_order_acquire) != pos + 1;
+      }
+
+      /**
+       * @brief Returns @c true if the slot for the next record is still taken.
+       */
+      bool full() const {
+        std::size_t const pos = _tail.load(std::memory_order_relaxed);
+        std::size_t const seq = _cells[pos & _mask].sequence.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(seq - pos) < 0;
+      }
+
+      /**
+       * @brief Writes the records waiting in the ring, oldest first, to the file descriptor
+       *        @p fd without taking them out of the ring. It is async-signal-safe; see
+       *        qlog::logger::salvage().
+       */
+      void salvage(int fd) const {
+        std::size_t const tail = _tail.load(std::memory_order_relaxed);
+        for(std::size_t pos = _head.load(std::memory_order_relaxed); pos != tail; ++pos) {
+          cell const& c = _cells[pos & _mask];
+          if(c.sequence.load(std::memory_order_acquire) == pos + 1) {
+            detail::write_fully(fd, c.record.data(), c.record.size());
+          }
+        }
+      }
+
+    private:
+      /**
+       * @brief Returns the smallest power of two that is at least @p c.
+       */
+      static std::size_t capacity_for(std::size_t c) {
+        std::size_t n = 2;
+        while(n < c) {
+          n <<= 1;
+        }
+        return n;
+      }
+
+      /**
+       * @brief Slot in the ring.
+       *
+       * The sequence equals the slot's position when it is free for a producer, and the position
+       * plus one when it holds a record for a consumer.
+       */
+      struct cell {
+        cell() : sequence(0), level(0) { }
+        std::atomic<std::size_t> sequence;
+        std::string record;
+        unsigned long level;
+      };
+
+      /** @brief Slots of the ring. */
+      std::vector<cell> _cells;
+
+      /** @brief Mask that maps a position to a slot index. */
+      std::size_t const _mask;
+
+      /** @brief Keeps the positions off the cache line of the fields above. */
+      char _pad0[64];
+
+      /** @brief Position of the next record to pop. */
+      std::atomic<std::size_t> _head;
+
+      /** @brief Keeps producers and the consumer from sharing a cache line. */
+      char _pad1[64 - sizeof(std::atomic<std::size_t>)];
+
+      /** @brief Position of the next record to push. */
+      std::atomic<std::size_t> _tail;
+
+      /** @brief Keeps the push position off the cache line of the fields that follow. */
+      char _pad2[64 - sizeof(std::atomic<std::size_t>)];
+  };
+
+  /**
+   * @brief Background thread that drains a qlog::record_ring to a qlog::sink.
+   *
+   * Logging threads hand complete lines to qlog::async_writer::push() and return as soon as the
+   * line is in the ring. A single background thread writes the lines to the sink, so a slow sink
+   * never stalls the threads that produce records. The lock is only taken to put the
+   * background thread to sleep when there is nothing to write and to wake it up again, and to
+   * put a producer to sleep when it has found a full queue with qlog::overflow_policy::block a
+   * few times in a row.
+   */
+  class async_writer {
+    public:
+      /**
+       * @brief Initializes a new qlog::async_writer and starts its background thread.
+       * @param[in] o Sink to which queued records are written.
+       * @param[in] c Maximum number of records that may be queued at once.
+       * @param[in] p What to do with a record when the queue is full.
+       * @param[in] f When the background thread writes the records it has gathered. The default
+       *              writes whenever the queue runs empty, and at once for errors.
+       */
+      async_writer(sink& o, std::size_t c, overflow_policy p,
+                   flush_policy const& f = flush_policy(0))
+        : _output(&o), _ring(c), _policy(p), _batch(f), _next(f), _renewed(false), _blocked(0),
+          _sleeping(false), _flushing(false), _stop(false), _done(false), _pushed(0),
+          _finished(0), _dropped(0), _high_water(0), _thread(&async_writer::run, this) {
+      }
+
+      async_writer(async_writer const&) = delete;
+      async_writer& operator=(async_writer const&) = delete;
+
+      /**
+       * @brief Destructor. Writes every queued record before returning.
+       */
+      ~async_writer() {
+        shutdown();
+      }
+
+      /**
+       * @brief Queues a finished record for the background thread.
+       * @param[in] d First byte of one or more complete, newline terminated records.
+       * @param[in] n Number of bytes to queue.
+       * @param[in] level Level of the severity of the record, which the flush policy looks at.
+       * @returns @c false if the record was discarded because the queue was full.
+       */
+      bool push(char const* d, std::size_t n, unsigned long level) {
+        if(_done.load(std::memory_order_acquire)) {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _output->write_record(d, n, level);
+          _output->flush();
+          return true;
+        }
+        unsigned spins = 0;
+        while(!_ring.try_push(d, n, level)) {
+          switch(_policy) {
+            case overflow_policy::block:
+              if(spins++ < block_spins) {
+                if(_sleeping.load(std::memory_order_relaxed)) {
+                  wake();
+                }
+                std::this_thread::yield();
+              } else {
+                wait_for_room();
+              }
+              break;
+            case overflow_policy::drop_newest:
+              _dropped.fetch_add(1, std::memory_order_relaxed);
+              return false;
+            case overflow_policy::drop_oldest:
+              if(_ring.try_discard()) {
+                _finished.fetch_add(1, std::memory_order_release);
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+              }
+              break;
+          }
+        }
+        std::size_t const pushed = _pushed.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t const finished = _finished.load(std::memory_order_relaxed);
+        std::size_t high = _high_water.load(std::memory_order_relaxed);
+        while(pushed > finished && pushed - finished > high &&
+              !_high_water.compare_exchange_weak(high, pushed - finished,
+                                                 std::memory_order_relaxed)) {
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(_sleeping.load(std::memory_order_relaxed)) {
+          wake();
+        }
+        return true;
+      }
+
+      /**
+       * @brief Waits until every record queued so far has been written and the sink flushed.
+       */
+      void flush() {
+        std::size_t const target = _pushed.load(std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _flushing.store(true, std::memory_order_relaxed);
+        _wake.notify_one();
+        _drained.wait(lock, [this, target] {
+          return _finished.load(std::memory_order_acquire) >= target ||
+                 _done.load(std::memory_order_relaxed);
+        });
+      }
+
+      /**
+       * @brief Writes every queued record and stops the background thread.
+       *
+       * Records pushed after the background thread has exited are written on the calling thread.
+       */
+      void shutdown() {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _stop = true;
+          _flushing.store(true, std::memory_order_relaxed);
+          _wake.notify_one();
+        }
+        if(_thread.joinable()) {
+          _thread.join();
+        }
+      }
+
+      /**
+       * @brief Returns the number of records discarded because the queue was full.
+       */
+      unsigned long long dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Returns the most records that ever waited at once to be written.
+       */
+      std::size_t high_water() const {
+        return _high_water.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Returns the histogram of how long the writes to the sink took.
+       */
+      detail::latency_histogram const& latency() const {
+        return _batch.latency();
+      }
+
+      /**
+       * @brief Writes the records that have been queued but not yet written, oldest first, to
+       *        the file descriptor @p fd. It is async-signal-safe; see qlog::logger::salvage().
+       */
+      void salvage(int fd) const {
+        _batch.salvage(fd);
+        _ring.salvage(fd);
+      }
+
+      /**
+       * @brief Changes when the background thread writes the records it has gathered.
+       *
+       * The background thread adopts the new policy the next time it runs out of records.
+       */
+      void set_flush_policy(flush_policy const& f) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _next = f;
+        _renewed = true;
+        _wake.notify_one();
+      }
+
+    private:
+      /** @brief Times a producer retries a full queue before it sleeps until there is room. */
+      static const unsigned block_spins = 32;
+
+      /**
+       * @brief Wakes the background thread if it is waiting for records.
+       */
+      void wake() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _wake.notify_one();
+      }
+
+      /**
+       * @brief Sleeps until the background thread has taken a record out of a full ring.
+       *
+       * The ring is checked under the lock that the background thread takes after each pass
+       * over the ring, and qlog::async_writer::_blocked tells it that someone is waiting, so the
+       * producer cannot miss the signal.
+       */
+      void wait_for_room() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_blocked;
+        _wake.notify_one();
+        _room.wait(lock, [this] {
+          return !_ring.full() || _done.load(std::memory_order_relaxed);
+        });
+        --_blocked;
+      }
+
+      /**
+       * @brief Body of the background thread.
+       *
+       * Gathers records from the ring into a batch, which is written whenever the flush policy
+       * says so, and then sleeps until a producer wakes it or the batch's deadline passes. A
+       * producer checks qlog::async_writer::_sleeping after publishing a record, and the
+       * background thread checks the ring after setting it, so a record is never left in the ring
+       * while the background thread sleeps.
+       */
+      void run() {
+        std::string r;
+        r.reserve(QLOG_RECORD_SIZE);
+        unsigned long level;
+        for(;;) {
+          std::size_t n = 0;
+          while(_ring.try_pop(r, level)) {
+            n += _batch.add(r.data(), r.size(), level, *_output);
+          }
+          if(!_batch.empty() && (_flushing.load(std::memory_order_relaxed) ||
+                                 _batch.policy().interval.count() == 0 || _batch.expired())) {
+            n += _batch.write(*_output);
+          }
+          if(n) {
+            _finished.fetch_add(n, std::memory_order_release);
+          }
+
+          std::unique_lock<std::mutex> lock(_mutex);
+          if(_renewed) {
+            _batch.set_policy(_next);
+            _renewed = false;
+          }
+          if(_blocked) {
+            _room.notify_all();
+          }
+          _drained.notify_all();
+          _sleeping.store(true, std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if(_ring.empty()) {
+            // A flush is over once everything queued before it has left the batch.
+            if(_batch.empty()) {
+              _flushing.store(false, std::memory_order_relaxed);
+              if(_stop) {
+                break;
+              }
+              _wake.wait(lock);
+            } else if(_stop) {
+              _flushing.store(true, std::memory_order_relaxed);
+            } else if(!_flushing.load(std::memory_order_relaxed)) {
+              _wake.wait_until(lock, _batch.deadline());
+            }
+          }
+          _sleeping.store(false, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done.store(true, std::memory_order_release);
+        _room.notify_all();
+        _drained.notify_all();
+      }
+
+      /** @brief Sink that receives queued records. */
+      sink* _output;
+
+      /** @brief Records waiting to be written. */
+      record_ring _ring;
+
+      /** @brief What to do with a record when the queue is full. */
+      overflow_policy _policy;
+
+      /** @brief Records taken from the ring but not yet written. */
+      record_batch _batch;
+
+      /** @brief Flush policy waiting to be adopted by the background thread. */
+      flush_policy _next;
+
+      /** @brief @c true if qlog::async_writer::_next has not been adopted yet. */
+      bool _renewed;
+
+      /** @brief Guards sleeping and waking the background thread. */
+      std::mutex _mutex;
+
+      /** @brief Signalled when a record is queued or the writer is stopping. */
+      std::condition_variable _wake;
+
+      /** @brief Signalled when the background thread has written everything it could find. */
+      std::condition_variable _drained;
+
+      /** @brief Signalled after a pass over the ring if producers wait for room in it. */
+      std::condition_variable _room;
+
+      /** @brief Number of producers waiting for room in the ring. */
+      unsigned _blocked;
+
+      /** @brief @c true while the background thread is, or is about to be, waiting for records. */
+      std::atomic<bool> _sleeping;
+
+      /** @brief @c true while a flush waits for the batch to be written. */
+      std::atomic<bool> _flushing;
+
+      /** @brief @c true once qlog::async_writer::shutdown() has been called. */
+      bool _stop;
+
+      /** @brief @c true once the background thread has written its last record and exited. */
+      std::atomic<bool> _done;
+
+      /** @brief Number of records that have been queued. */
+      std::atomic<std::size_t> _pushed;
+
+      /** @brief Number of queued records that have been written or discarded. */
+      std::atomic<std::size_t> _finished;
+
+      /** @brief Number of records discarded because the queue was full. */
+      std::atomic<unsigned long long> _dropped;
+
+      /** @brief Most records that ever waited at once to be written. */
+      std::atomic<std::size_t> _high_water;
+
+      /** @brief Background thread that drains the queue. */
+      std::thread _thread;
+  };
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief One sink of a qlog::logger, with the level of the records it receives and, if it
+     *        has a queue of its own, the background writer that drains it.
+     *
+     * A route without a queue writes on the thread that finishes the record, under a lock of its
+     * own, so two synchronous sinks never wait for each other's lock.
+     */
+    class route {
+      public:
+        /**
+         * @brief Initializes a new synchronous qlog::detail::route.
+         * @param[in] o Sink that receives the records.
+         * @param[in] l Level of the least severe records the sink receives.
+         */
+        route(sink& o, unsigned long l) : _output(&o), _level(l) { }
+
+        /**
+         * @brief Initializes a new qlog::detail::route with a queue and a background writer.
+         * @param[in] o Sink that receives the records.
+         * @param[in] l Level of the least severe records the sink receives.
+         * @param[in] c Maximum number of records waiting to be written.
+         * @param[in] p What to do with a record when @p c records are already waiting.
+         */
+        route(sink& o, unsigned long l, std::size_t c, overflow_policy p)
+          : _output(&o), _level(l), _writer(new async_writer(o, c, p)) {
+        }
+
+        route(route const&) = delete;
+        route& operator=(route const&) = delete;
+
+        /**
+         * @brief Writes or queues a finished record, if the sink receives records of its level.
+         */
+        void push(char const* d, std::size_t n, unsigned long level) {
+          if(level > _level) {
+            return;
+          }
+          if(_writer) {
+            _writer->push(d, n, level);
+          } else {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batch.add(d, n, level, *_output);
+          }
+        }
+
+        /**
+         * @brief Waits until every record handed to the route so far has reached the sink.
+         */
+        void flush() {
+          if(_writer) {
+            _writer->flush();
+          } else {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batch.write(*_output);
+          }
+        }
+
+        /**
+         * @brief Writes every record and stops the background writer, if there is one.
+         */
+        void shutdown() {
+          if(_writer) {
+            _writer->shutdown();
+          } else {
+            flush();
+          }
+        }
+
+        /**
+         * @brief Changes when finished records are written to the sink.
+         */
+        void set_flush_policy(flush_policy const& f) {
+          if(_writer) {
+            _writer->set_flush_policy(f);
+          } else {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batch.set_policy(f);
+          }
+        }
+
+        /**
+         * @brief Returns the number of records discarded because the queue was full.
+         */
+        unsigned long long dropped() const {
+          return _writer ? _writer->dropped() : 0;
+        }
+
+        /**
+         * @brief Adds the route's drops, queue depth and write latencies to @p m.
+         */
+        void add_to(log_metrics& m) const {
+          if(_writer) {
+            m.dropped += _writer->dropped();
+            if(_writer->high_water() > m.queue_high_water) {
+              m.queue_high_water = _writer->high_water();
+            }
+            _writer->latency().add_to(m);
+          } else {
+            _batch.latency().add_to(m);
+          }
+        }
+
+        /**
+         * @brief Writes the records handed to the route but not yet to its sink to the file
+         *        descriptor @p fd, without taking the lock. It is async-signal-safe.
+         */
+        void salvage(int fd) const {
+          if(_writer) {
+            _writer->salvage(fd);
+          } else {
+            _batch.salvage(fd);
+          }
+        }
+
+      private:
+        /** @brief Sink that receives the records. */
+        sink* const _output;
+
+        /** @brief Level of the least severe records the sink receives. */
+        unsigned long const _level;
+
+        /** @brief Serializes writes to the sink when the route has no queue. */
+        std::mutex _mutex;
+
+        /** @brief Records finished but not yet written when the route has no queue. */
+        record_batch _batch;
+
+        /** @brief Background writer, or @c nullptr when the route has no queue. */
+        std::unique_ptr<async_writer> _writer;
+    };
+  }
+
+  class logger;
+  class category;
+  class record;
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Stream buffer that appends everything written to it to a qlog::record_buffer.
+     *
+     * This is how values of types that only support @c std::ostream insertion are formatted.
+     */
+    class buffer_buf : public std::streambuf {
+      public:
+        /**
+         * @brief Initializes a new qlog::detail::buffer_buf that appends to @p b.
+         */
+        explicit buffer_buf(record_buffer& b) : _buffer(&b) { }
+
+      protected:
+        int_type overflow(int_type c) override {
+          if(!traits_type::eq_int_type(c, traits_type::eof())) {
+            _buffer->push_back(traits_type::to_char_type(c));
+          }
+          return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(char const* s, std::streamsize n) override {
+          _buffer->append(s, static_cast<std::size_t>(n));
+          return n;
+        }
+
+      private:
+        /** @brief Buffer that receives the output. */
+        record_buffer* _buffer;
+    };
+
+    /**
+     * @brief A record that the calling thread is formatting.
+     *
+     * Each thread has its own, so threads that share a qlog::logger never touch each other's
+     * severity or text, and a record started while one of the thread's qlog::record objects is
+     * still open gets one more of its own; see qlog::detail::thread_records. A record is finished
+     * when the qlog::record that started it is destroyed, or, for insertions made straight into
+     * the log, when the thread starts its next record, flushes the log, or exits.
+     */
+    struct thread_record {
+      thread_record() : owner(nullptr), id(0), severity(all.level), admitted(false),
+          pending(false), held(false), outer(nullptr), encoding(nullptr), stamp_size(0),
+          name_size(0), category_size(0), buf(text), stream(&buf) { }
+
+      /**
+       * @brief Returns @c true if the stream has its default formatting state, so that the
+       *        values it would format can be written directly instead.
+       */
+      bool plain() const {
+        return stream.flags() == (std::ios_base::dec | std::ios_base::skipws) &&
+               stream.width() == 0 && stream.precision() == 6;
+      }
+
+      /**
+       * @brief Formats any value that has a @c std::ostream insertion operator.
+       */
+      template<typename T>
+      void insert(T const& v) {
+        stream << v;
+      }
+
+      /**
+       * @brief Formats built-in values straight into qlog::detail::thread_record::text. Each
+       *        produces the same text as the stream would, except that floating point values
+       *        take as many digits as they need to read back exactly.
+       */
+      void insert(bool v) { plain() ? text.push_back(v ? '1' : '0') : insert<bool>(v); }
+      void insert(char v) { text.push_back(v); }
+      void insert(signed char v) { text.push_back(static_cast<char>(v)); }
+      void insert(unsigned char v) { text.push_back(static_cast<char>(v)); }
+      void insert(short v) { integer(v); }
+      void insert(unsigned short v) { integer(v); }
+      void insert(int v) { integer(v); }
+      void insert(unsigned v) { integer(v); }
+      void insert(long v) { integer(v); }
+      void insert(unsigned long v) { integer(v); }
+      void insert(long long v) { integer(v); }
+      void insert(unsigned long long v) { integer(v); }
+      void insert(float v) { real(v); }
+      void insert(double v) { real(v); }
+
+      void insert(char const* v) {
+        if(stream.width() != 0) {
+          stream << v;
+        } else if(v) {
+          text.append(v, std::strlen(v));
+        } else {
+          text.append("(null)", 6);
+        }
+      }
+
+      void insert(char* v) { insert(static_cast<char const*>(v)); }
+
+      void insert(std::string const& v) {
+        stream.width() == 0 ? text.append(v.data(), v.size()) : insert<std::string>(v);
+      }
+
+      /**
+       * @brief Formats the address held by an object pointer. Function pointers, such as
+       *        @c std::hex, are still given to the stream.
+       */
+      template<typename T>
+      typename std::enable_if<!std::is_function<T>::value>::type insert(T* v) {
+        if(!plain()) {
+          stream << static_cast<void const*>(v);
+        } else if(char* b = text.reserve(18)) {
+          text.commit(format_pointer(b, v));
+        }
+      }
+
+      /** @brief Formats an integer of any width. */
+      template<typename T>
+      void integer(T v) {
+        if(!plain()) {
+          stream << v;
+        } else if(char* b = text.reserve(20)) {
+          text.commit(std::is_signed<T>::value
+            ? format_decimal(b, static_cast<long long>(v))
+            : format_decimal(b, static_cast<unsigned long long>(v)));
+        }
+      }
+
+      /** @brief Formats a floating point value. */
+      void real(double v) {
+        if(!plain()) {
+          stream << v;
+        } else if(char* b = text.reserve(24)) {
+          text.commit(format_double(b, v));
+        }
+      }
+
+      /**
+       * @brief Adds a structured field of any type that has a @c std::ostream insertion
+       *        operator, which becomes a text field.
+       */
+      template<typename T>
+      void add_field(char const* k, std::size_t n, T const& v) {
+        std::size_t const mark = text.size();
+        stream << v;
+        fields.add(k, n, text.data() + mark, text.size() - mark);
+        text.resize(mark);
+      }
+
+      /**
+       * @brief Adds structured fields of built-in types, keeping their type for the encoder.
+       */
+      void add_field(char const* k, std::size_t n, bool v) {
+        if(field* f = fields.add(k, n, field::kind::boolean)) {
+          f->value.boolean = v;
+        }
+      }
+
+      void add_field(char const* k, std::size_t n, char v) { fields.add(k, n, &v, 1); }
+      void add_field(char const* k, std::size_t n, short v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, unsigned short v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, int v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, unsigned v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, long v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, unsigned long v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, long long v) { integer_field(k, n, v); }
+      void add_field(char const* k, std::size_t n, unsigned long long v) {
+        integer_field(k, n, v);
+      }
+
+      void add_field(char const* k, std::size_t n, float v) {
+        add_field(k, n, static_cast<double>(v));
+      }
+
+      void add_field(char const* k, std::size_t n, double v) {
+        if(field* f = fields.add(k, n, field::kind::real)) {
+          f->value.real = v;
+        }
+      }
+
+      void add_field(char const* k, std::size_t n, char const* v) {
+        v ? fields.add(k, n, v, std::strlen(v)) : fields.add(k, n, "(null)", 6);
+      }
+
+      void add_field(char const* k, std::size_t n, char* v) {
+        add_field(k, n, static_cast<char const*>(v));
+      }
+
+      void add_field(char const* k, std::size_t n, std::string const& v) {
+        fields.add(k, n, v.data(), v.size());
+      }
+
+      /** @brief Adds a structured field holding an integer of any width. */
+      template<typename T>
+      void integer_field(char const* k, std::size_t n, T v) {
+        if(std::is_signed<T>::value) {
+          if(field* f = fields.add(k, n, field::kind::integer)) {
+            f->value.integer = static_cast<long long>(v);
+          }
+        } else if(field* f = fields.add(k, n, field::kind::unsigned_integer)) {
+          f->value.unsigned_integer = static_cast<unsigned long long>(v);
+        }
+      }
+
+      /**
+       * @brief Returns the parts of the record for its encoder.
+       */
+      record_view view() const {
+        record_view v;
+        v.timestamp = stamp;
+        v.timestamp_size = stamp_size;
+        v.severity = head.data();
+        v.severity_size = name_size;
+        v.category = category_size ? head.data() + name_size : nullptr;
+        v.category_size = category_size;
+        v.message = text.data();
+        v.message_size = text.size();
+        v.fields = &fields;
+        return v;
+      }
+
+      /**
+       * @brief Empties the record once it has been handed to its log.
+       */
+      void clear() {
+        text.clear();
+        fields.clear();
+        head.clear();
+        stamp_size = 0;
+        name_size = 0;
+        category_size = 0;
+        pending = false;
+      }
+
+      /**
+       * @brief Destructor. Hands a record that is still pending to its log.
+       */
+      ~thread_record() {
+        release();
+      }
+
+      /**
+       * @brief Hands a pending record to its log, if the log still exists, and detaches from it.
+       */
+      void release();
+
+      /** @brief Log that the record belongs to. */
+      logger* owner;
+
+      /** @brief Identifier of the log, which tells it from a later log at the same address. */
+      unsigned long long id;
+
+      /** @brief Severity level of the record. */
+      unsigned long severity;
+
+      /** @brief @c true if the log's filter let the record through when it was started. */
+      bool admitted;
+
+      /** @brief @c true when the record holds text that has not been handed to its log. */
+      bool pending;
+
+      /** @brief @c true while a qlog::record is open on the record. */
+      bool held;
+
+      /** @brief Record below this one on the thread's stack, or @c nullptr for the first. */
+      thread_record* outer;
+
+      /** @brief Record above this one on the thread's stack, kept once it has been needed. */
+      std::unique_ptr<thread_record> inner;
+
+      /**
+       * @brief Encoder of the record, or @c nullptr if it is written as text as it is formatted.
+       */
+      encoder const* encoding;
+
+      /** @brief Timestamp of a record with an encoder. */
+      char stamp[timestamp_cache::max_size];
+
+      /** @brief Length of qlog::detail::thread_record::stamp. */
+      std::size_t stamp_size;
+
+      /**
+       * @brief Name of the severity followed by the name of the category, for a record with an
+       *        encoder.
+       */
+      record_buffer head;
+
+      /** @brief Length of the name of the severity in qlog::detail::thread_record::head. */
+      std::size_t name_size;
+
+      /** @brief Length of the name of the category in qlog::detail::thread_record::head. */
+      std::size_t category_size;
+
+      /** @brief Text of the record, which is the message of a record with an encoder. */
+      record_buffer text;
+
+      /** @brief Structured fields of the record. */
+      record_fields fields;
+
+      /** @brief Encoded record, which is what a record with an encoder hands to its log. */
+      record_buffer encoded;
+
+      /** @brief Stream buffer that appends to qlog::detail::thread_record::text. */
+      buffer_buf buf;
+
+      /** @brief Stream used to format insertions. */
+      std::ostream stream;
+
+      /** @brief The calling thread's timestamp cache. */
+      timestamp_cache timestamps;
+    };
+
+    /**
+     * @brief A @c T for each thread that outlives the thread's own copy.
+     *
+     * A thread's copy is destroyed with its other thread locals, and on the main thread that
+     * happens before static objects are destroyed. A thread that still needs its @c T after that,
+     * like the destructor of a static object that logs, is given one that is never destroyed.
+     */
+    template<typename T>
+    struct thread_instance {
+      /**
+       * @brief Destructor. Sends the thread's later calls to get() to the replacement.
+       */
+      ~thread_instance() {
+        gone() = true;
+      }
+
+      /**
+       * @brief Returns the calling thread's @c T.
+       */
+      static T& get() {
+        if(gone()) {
+          // Storage with no destructor, so the replacement is never destroyed.
+          static thread_local typename std::aligned_storage<sizeof(T), alignof(T)>::type late;
+          static thread_local bool built = false;
+          if(!built) {
+            new(&late) T;
+            built = true;
+          }
+          return *reinterpret_cast<T*>(&late);
+        }
+        static thread_local thread_instance i;
+        return i.value;
+      }
+
+      /**
+       * @brief Returns @c true once the calling thread's copy has been destroyed.
+       */
+      static bool& gone() {
+        static thread_local bool g = false;
+        return g;
+      }
+
+      /** @brief The thread's copy. */
+      T value;
+    };
+
+    /**
+     * @brief The records that the calling thread is formatting, innermost on top.
+     *
+     * A record started while the top one is held by an open qlog::record, such as one written by
+     * a function called in the middle of another record's insertions, goes into the next record
+     * up, so the open one is neither cut short nor mixed with it. Records above the first are
+     * allocated the first time a thread nests that deep and reused after that.
+     */
+    struct thread_records {
+      thread_records() : top(&first) {
+        existing() = this;
+      }
+
+      /**
+       * @brief Destructor. The records are handed to their logs, the first one first.
+       */
+      ~thread_records() {
+        existing() = nullptr;
+      }
+
+      /**
+       * @brief Returns the calling thread's records, or @c nullptr if it has none yet.
+       *
+       * Unlike qlog::detail::this_thread_records(), this never creates them, so a signal handler
+       * may call it.
+       */
+      static thread_records*& existing() {
+        static thread_local thread_records* r = nullptr;
+        return r;
+      }
+
+      /**
+       * @brief Makes the record above the top one the new top.
+       * @returns the new top record, which is empty.
+       */
+      thread_record& push() {
+        if(!top->inner) {
+          top->inner.reset(new thread_record);
+          top->inner->outer = top;
+        }
+        top = top->inner.get();
+        return *top;
+      }
+
+      /**
+       * @brief Moves the top down past the records that are neither held nor pending.
+       */
+      void pop() {
+        while(top->outer && !top->held && !top->pending) {
+          top = top->outer;
+        }
+      }
+
+      /** @brief The thread's first record, which insertions made straight into a log use. */
+      thread_record first;
+
+      /** @brief Innermost record in use. */
+      thread_record* top;
+    };
+
+    /**
+     * @brief Returns the calling thread's records.
+     */
+    inline thread_records& this_thread_records() {
+      return thread_instance<thread_records>::get();
+    }
+
+    /**
+     * @brief Returns the calling thread's innermost record.
+     */
+    inline thread_record& this_thread_record() {
+      return *this_thread_records().top;
+    }
+
+    /**
+     * @brief Loggers that are alive, by address and identifier.
+     *
+     * A thread that moves on to another log, or exits, consults this to find out whether it may
+     * still hand its pending record to the log it was using.
+     */
+    struct registry {
+      /** @brief Guards qlog::detail::registry::live. */
+      std::mutex mutex;
+
+      /** @brief Identifier of each live log. */
+      std::unordered_map<logger const*, unsigned long long> live;
+
+      /** @brief Source of log identifiers. */
+      unsigned long long next_id = 0;
+    };
+
+    /**
+     * @brief Returns the process-wide registry of live loggers.
+     *
+     * It is never destroyed, so loggers and threads may still use it while static objects are
+     * being destroyed.
+     */
+    inline registry& loggers() {
+      static registry* const r = new registry;
+      return *r;
+    }
+  }
+
+  /**
+   * @brief One record being written, from the statement that starts it to the end of that
+   *        statement.
+   *
+   * qlog::logger::operator()() returns a record, and the insertions that follow go into it. When
+   * the record is destroyed, normally at the end of the statement, the whole line is handed to
+   * the log's sinks, so each statement reaches them as one complete record without waiting for
+   * the next one. The text is formatted into a buffer the calling thread keeps, so a record
+   * allocates nothing and costs no more than two pointers to return. A record started while
+   * another is still open, by a function called among its insertions or in a loop that builds
+   * it, gets a buffer of its own and is written on its own, leaving the open one whole. A record
+   * can be moved, to build it over several statements, but not copied, and must be destroyed on
+   * the thread that started it. For example:
+   *
+   *     log(qlog::info) << "one line";        // written here
+   *     qlog::record r = log(qlog::info);
+   *     for(auto const& item : items) {
+   *       r << item << ' ';
+   *       log(qlog::debug) << "saw " << item;  // written here, on its own
+   *     }
+   *                                            // r is written when it goes out of scope
+   */
+  class record {
+    public:
+      /**
+       * @brief Takes over the record of @p o, which is left empty.
+       */
+      record(record&& o) : _log(o._log), _record(o._record) {
+        o._log = nullptr;
+      }
+
+      record(record const&) = delete;
+      record& operator=(record const&) = delete;
+
+      /**
+       * @brief Destructor. Hands the finished record to the log.
+       */
+      ~record();
+
+      /**
+       * @brief Inserts a value into the record. See qlog::logger::operator<<().
+       * @returns a reference to the record for chaining.
+       */
+      template<typename T>
+      record& operator<<(T&& o);
+
+      /**
+       * @brief Applies a @c std::ostream manipulator to the record.
+       * @returns a reference to the record for chaining.
+       */
+      record& operator<<(std::ostream& (*p)(std::ostream&));
+
+      /**
+       * @brief Adds a structured field to the record. See qlog::logger::kv().
+       * @returns a reference to the record for chaining.
+       */
+      template<typename T>
+      record& kv(char const* key, T const& v);
+
+      /**
+       * @brief Adds a structured field to the record. See qlog::logger::kv().
+       * @returns a reference to the record for chaining.
+       */
+      template<typename T>
+      record& kv(std::string const& key, T const& v);
+
+    private:
+      friend class logger;
+      friend class category;
+
+      /**
+       * @brief Initializes a new qlog::record for the record @p r just started on @p l.
+       */
+      record(logger& l, detail::thread_record& r) : _log(&l), _record(&r) {
+        r.held = true;
+      }
+
+      /** @brief Log the record belongs to, or @c nullptr once it has been moved from. */
+      logger* _log;
+
+      /** @brief The calling thread's record that the insertions go into. */
+      detail::thread_record* _record;
+  };
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Returns the kernel's identifier of the calling thread, asked for once per thread.
+     */
+    inline long thread_id() {
+      static thread_local long const id = ::syscall(SYS_gettid);
+      return id;
+    }
+
+    /**
+     * @brief Key and value pairs of the calling thread that are stamped on each of its records.
+     */
+    struct thread_context {
+      /**
+       * @brief Renders the pairs into qlog::detail::thread_context::text.
+       */
+      void render() {
+        text.clear();
+        if(entries.empty()) {
+          return;
+        }
+        record_buffer b;
+        b.push_back('[');
+        for(auto const& e : entries) {
+          if(b.size() > 1) {
+            b.push_back(' ');
+          }
+          b.append(e.first.data(), e.first.size());
+          b.push_back('=');
+          append_bare(b, e.second.data(), e.second.size());
+        }
+        b.append("] ", 2);
+        text.assign(b.data(), b.size());
+      }
+
+      /** @brief The pairs, in the order they were first set. */
+      std::vector<std::pair<std::string, std::string>> entries;
+
+      /** @brief The pairs rendered as @c [key=value ...] followed by a space, or nothing. */
+      std::string text;
+    };
+
+    /**
+     * @brief Returns the calling thread's context.
+     */
+    inline thread_context& this_thread_context() {
+      return thread_instance<thread_context>::get();
+    }
+  }
+
+  /**
+   * @brief Mapped diagnostic context: key and value pairs that the calling thread stamps on
+   *        every record it starts.
+   *
+   * The pairs are rendered once whenever they change, and the rendered text is copied into each
+   * record after its severity and category, so stamping them costs one copy per record. Records
+   * with an encoder get the pairs as text fields ahead of their own. For example:
+   *
+   *     qlog::context::set_thread_id();
+   *     qlog::context_scope request("request", id);
+   *     log(qlog::info) << "started";  // ... [INFO] [thread=4242 request=abc] started
+   */
+  class context {
+    public:
+      /**
+       * @brief Sets the value of @p key, adding it after the other keys if it is new.
+       */
+      static void set(std::string const& key, std::string const& value) {
+        detail::thread_context& c = detail::this_thread_context();
+        for(auto& e : c.entries) {
+          if(e.first == key) {
+            e.second = value;
+            c.render();
+            return;
+          }
+        }
+        c.entries.emplace_back(key, value);
+        c.render();
+      }
+
+      /**
+       * @brief Sets @c thread to the kernel's identifier of the calling thread.
+       */
+      static void set_thread_id() {
+        set("thread", std::to_string(detail::thread_id()));
+      }
+
+      /**
+       * @brief Returns the value of @p key, or @c nullptr if it has none.
+       */
+      static std::string const* get(std::string const& key) {
+        for(auto const& e : detail::this_thread_context().entries) {
+          if(e.first == key) {
+            return &e.second;
+          }
+        }
+        return nullptr;
+      }
+
+      /**
+       * @brief Removes @p key.
+       * @returns @c false if it was not set.
+       */
+      static bool erase(std::string const& key) {
+        detail::thread_context& c = detail::this_thread_context();
+        for(auto i = c.entries.begin(); i != c.entries.end(); ++i) {
+          if(i->first == key) {
+            c.entries.erase(i);
+            c.render();
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /**
+       * @brief Removes every key.
+       */
+      static void clear() {
+        detail::thread_context& c = detail::this_thread_context();
+        c.entries.clear();
+        c.render();
+      }
+
+      /**
+       * @brief Returns the rendered text that is copied into each record.
+       */
+      static std::string const& text() {
+        return detail::this_thread_context().text;
+      }
+  };
+
+  /**
+   * @brief Sets a key of the calling thread's qlog::context for as long as it exists, and then
+   *        puts back the value the key had before.
+   */
+  class context_scope {
+    public:
+      /**
+       * @brief Initializes a new qlog::context_scope and sets @p key to @p value.
+       */
+      context_scope(std::string const& key, std::string const& value) : _key(key) {
+        std::string const* const previous = context::get(key);
+        _had = previous != nullptr;
+        if(previous) {
+          _previous = *previous;
+        }
+        context::set(key, value);
+      }
+
+      context_scope(context_scope const&) = delete;
+      context_scope& operator=(context_scope const&) = delete;
+
+      /**
+       * @brief Destructor. Puts back the key's previous value, or removes the key.
+       */
+      ~context_scope() {
+        if(_had) {
+          context::set(_key, _previous);
+        } else {
+          context::erase(_key);
+        }
+      }
+
+    private:
+      /** @brief Key that the scope sets. */
+      std::string const _key;
+
+      /** @brief @c true if the key had a value before. */
+      bool _had;
+
+      /** @brief Value the key had before. */
+      std::string _previous;
+  };
+
+  /**
+   * @brief Simple logging class.
+   *
+   * A logger may be shared by any number of threads. Each thread formats its records into its own
+   * buffer, and each finished record reaches the output stream as one complete line.
+   */
+  class logger {
+    friend class category;
+    friend class record;
+    friend struct detail::thread_record;
+
+    public:
+      /**
+       * @brief Initializes a new qlog::logger instance with a verbosity level.
+       */
+      logger(severity_t const& v)
+        : _stream(new ostream_sink(std::cerr)), _verbosity(v.level), _encoder(nullptr),
+          _precision(timestamp_precision::milliseconds), _clock(clock_policy::wall) {
+        _routes.emplace_back(new detail::route(*_stream, QLOG_LEVEL_INHERIT));
+        enroll();
+      }
+
+      /**
+       * @brief Initializes a new qlog::logger instance with an output stream and verbosity level.
+       * @param[in] o Stream to which logging output is sent.
+       * @param[in] v Default verbosity level of the log.
+       */
+      logger(std::ostream& o = std::cerr, severity_t const& v = all)
+        : _stream(new ostream_sink(o)), _verbosity(v.level), _encoder(nullptr),
+          _precision(timestamp_precision::milliseconds), _clock(clock_policy::wall) {
+        _routes.emplace_back(new detail::route(*_stream, QLOG_LEVEL_INHERIT));
+        enroll();
+      }
+
+      /**
+       * @brief Initializes a new qlog::logger instance with a sink and verbosity level.
+       * @param[in] o Sink to which logging output is sent. It must outlive the log.
+       * @param[in] v Default verbosity level of the log.
+       */
+      logger(sink& o, severity_t const& v = all)
+        : _verbosity(v.level), _encoder(nullptr), _precision(timestamp_precision::milliseconds),
+          _clock(clock_policy::wall) {
+        _routes.emplace_back(new detail::route(o, QLOG_LEVEL_INHERIT));
+        enroll();
+      }
+
+      /**
+       * @brief Initializes a new asynchronous qlog::logger instance.
+       * @param[in] o Stream to which logging output is sent by a background thread.
+       * @param[in] v Default verbosity level of the log.
+       * @param[in] c Maximum number of records waiting to be written. The queue reserves
+       *              QLOG_RECORD_SIZE bytes for each.
+       * @param[in] p What to do with a record when @p c records are already waiting.
+       *
+       * Each record is formatted on the calling thread and queued once it is complete, which is
+       * at the end of the statement that wrote it; see qlog::record. For example:
+       *
+       *     std::ofstream log_file("error.log", std::ios::app);
+       *     qlog::logger log(log_file, qlog::all, 4096, qlog::overflow_policy::drop_oldest);
+       */
+      logger(std::ostream& o, severity_t const& v, std::size_t c,
+             overflow_policy p = overflow_policy::block)
+        : _stream(new ostream_sink(o)), _verbosity(v.level), _encoder(nullptr),
+          _precision(timestamp_precision::milliseconds), _clock(clock_policy::wall) {
+        _routes.emplace_back(new detail::route(*_stream, QLOG_LEVEL_INHERIT, c, p));
+        enroll();
+      }
+
+      /**
+       * @brief Initializes a new asynchronous qlog::logger instance with a sink.
+       * @param[in] o Sink to which logging output is sent by a background thread. It must
+       *              outlive the log.
+       * @param[in] v Default verbosity level of the log.
+       * @param[in] c Maximum number of records waiting to be written. The queue reserves
+       *              QLOG_RECORD_SIZE bytes for each.
+       * @param[in] p What to do with a record when @p c records are already waiting.
+       */
+      logger(sink& o, severity_t const& v, std::size_t c,
+             overflow_policy p = overflow_policy::block)
+        : _verbosity(v.level), _encoder(nullptr), _precision(timestamp_precision::milliseconds),
+          _clock(clock_policy::wall) {
+        _routes.emplace_back(new detail::route(o, QLOG_LEVEL_INHERIT, c, p));
+        enroll();
+      }
+
+      logger(logger const&) = delete;
+      logger& operator=(logger const&) = delete;
+
+      /**
+       * @brief Destructor. Calls shutdown().
+       */
+      ~logger() {
+        {
+          detail::registry& reg = detail::loggers();
+          std::lock_guard<std::mutex> lock(reg.mutex);
+          reg.live.erase(this);
+        }
+        shutdown();
+      }
+
+      /**
+       * @brief Generates the timestamp and log level at the beginning of the line.
+       * @param[in] l Severity level of the entry.
+       *
+       * This is used to generate the timestamp and emit the severity level of the message that
+       * follows. For example:
+       *
+       *     auto log = qlog::logger;
+       *     log(qlog::debug) << "This is a debug message";
+       *
+       * @returns the new record, which is written when it is destroyed at the end of the
+       *          statement; see qlog::record.
+       */
+      record operator()(severity_t const& l) {
+        return record(*this, start(l, enabled(l), nullptr, 0));
+      }
+
+      /**
+       * @brief Returns @c true if records of severity @p l are written to this log.
+       *
+       * The QLOG() and QLOG_AT() macros call this before starting a record, so that nothing is
+       * evaluated for a record that would be filtered out.
+       */
+      bool enabled(severity_t const& l) const {
+        bool const admitted = l.level <= verbosity();
+        if(!admitted) {
+          count_filtered(l.level);
+        }
+        return admitted;
+      }
+
+      /**
+       * @brief Returns the level of the least severe records that are written to this log.
+       */
+      unsigned long verbosity() const {
+        return _verbosity.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Changes which records are written to this log.
+       * @param[in] v Records whose severity is at most as high as this are written.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * Any thread may call this at any time. It is a single lock-free store, so it may also be
+       * called from a signal handler; see qlog::verbosity_signals. Records already started keep
+       * the decision made when they were started.
+       */
+      logger& set_verbosity(severity_t const& v) {
+        return set_verbosity(v.level);
+      }
+
+      /**
+       * @brief Changes which records are written to this log.
+       * @param[in] v Level of the least severe records that are written.
+       * @returns a reference to the @c logger object for chaining.
+       */
+      logger& set_verbosity(unsigned long v) {
+        _verbosity.store(v, std::memory_order_relaxed);
+        return *this;
+      }
+
+      /**
+       * @brief Insertion operator that accepts any value, constant or not.
+       * @param[in] o Value to emit.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * Booleans, characters, integers, floating point values, strings and pointers are formatted
+       * straight into the record without a stream. Values of any other type are given to their
+       * @c std::ostream insertion operator.
+       */
+      template<typename T>
+      logger& operator<<(T&& o) {
+        detail::thread_record& r = current();
+        if(r.admitted) {
+          r.insert(std::forward<T>(o));
+          r.pending = true;
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Adds a structured field to the calling thread's current record.
+       * @param[in] key Name of the field. It is copied, so it need not outlive the call.
+       * @param[in] v Value of the field. Booleans, integers and floating point values keep their
+       *              type; anything else is formatted as text, as the insertion operator would.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * How the fields are written depends on the log's encoder; see qlog::logger::set_encoder().
+       * Without one, they follow the message as @c key=value pairs. For example:
+       *
+       *     log(qlog::info).kv("latency_us", n).kv("path", p) << "request done";
+       *     // 2014-06-01T12:34:56.789Z [INFO] request done latency_us=12 path=/index.html
+       *
+       * A record holds at most QLOG_RECORD_FIELDS fields, and their keys and text share
+       * QLOG_RECORD_SIZE bytes; fields that do not fit are dropped.
+       */
+      template<typename T>
+      logger& kv(char const* key, T const& v) {
+        detail::thread_record& r = current();
+        if(r.admitted) {
+          r.add_field(key, std::strlen(key), v);
+          r.pending = true;
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Adds a structured field to the calling thread's current record.
+       * @param[in] key Name of the field.
+       * @param[in] v Value of the field.
+       * @returns a reference to the @c logger object for chaining.
+       */
+      template<typename T>
+      logger& kv(std::string const& key, T const& v) {
+        detail::thread_record& r = current();
+        if(r.admitted) {
+          r.add_field(key.data(), key.size(), v);
+          r.pending = true;
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Specialized insertion operator that accepts @c std::ostream manipulators.
+       * @param[in] p Pointer to the @c std::ostream manipulator function.
+       * @returns a reference to the @c logger object for chaining.
+       */
+      logger& operator<<(std::ostream& (*p)(std::ostream&)) {
+        p(current().stream);
+        return *this;
+      }
+
+      /**
+       * @brief Waits until every record emitted so far has reached the output stream.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * This finishes the calling thread's pending record, unless a qlog::record is still open on
+       * it. Records that other threads are still formatting are written when those threads finish
+       * them.
+       */
+      logger& flush() {
+        detail::thread_record& r = detail::this_thread_record();
+        if(owns(r) && !r.held) {
+          commit(r);
+        }
+        for(auto& route : _routes) {
+          route->flush();
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Writes every record emitted so far and stops the background threads of an
+       *        asynchronous log.
+       *
+       * This finishes the calling thread's pending record, unless a qlog::record is still open on
+       * it. Records that other threads are still formatting are written when those threads finish
+       * them, and so are open records and records started after the log was shut down, but on the
+       * thread that wrote them and straight to the sinks. Calling it more than once does no harm.
+       */
+      void shutdown() {
+        detail::thread_record& r = detail::this_thread_record();
+        if(owns(r) && !r.held) {
+          commit(r);
+          r.owner = nullptr;
+        }
+        for(auto& route : _routes) {
+          route->shutdown();
+        }
+      }
+
+      /**
+       * @brief Returns the number of records an asynchronous log discarded because its queues
+       *        were full, summed over its sinks.
+       */
+      unsigned long long dropped() const {
+        unsigned long long n = 0;
+        for(auto const& route : _routes) {
+          n += route->dropped();
+        }
+        return n;
+      }
+
+      /**
+       * @brief Returns the log's counters: the records finished and filtered out by severity,
+       *        their bytes, the records dropped by full queues and by rate limits, the deepest
+       *        queue, and how long the writes to the sinks took.
+       *
+       * Each thread counts records in a copy of the counters of its own, without a lock, and this
+       * adds the copies up, so the counters of records finished at the same moment may or may
+       * not be included. With QLOG_COUNT_FILTERED set, a record is counted as filtered each time
+       * enabled() turns it away. For example, to export them:
+       *
+       *     qlog::write_prometheus(response, log.metrics());  // see qlog/metrics.hpp
+       */
+      log_metrics metrics() const {
+        log_metrics m;
+        for(detail::metric_shard const& shard : _shards) {
+          for(std::size_t i = 0; i < log_metrics::levels; ++i) {
+            m.emitted[i] += shard.emitted[i].load(std::memory_order_relaxed);
+            m.filtered[i] += shard.filtered[i].load(std::memory_order_relaxed);
+          }
+          m.bytes += shard.bytes.load(std::memory_order_relaxed);
+          m.suppressed += shard.suppressed.load(std::memory_order_relaxed);
+        }
+        for(auto const& route : _routes) {
+          route->add_to(m);
+        }
+        return m;
+      }
+
+      /**
+       * @brief Counts a record that a qlog::rate_limit suppressed.
+       */
+      void count_suppressed() {
+#if QLOG_METRICS
+        _shards[detail::metric_shard_index()].suppressed.fetch_add(1, std::memory_order_relaxed);
+#endif
+      }
+
+      /**
+       * @brief Writes every record the log has finished but not yet handed to its sink, and the
+       *        calling thread's pending record, to a file descriptor.
+       * @param[in] fd File descriptor that receives the records, such as @c STDERR_FILENO or a
+       *               crash file opened in advance.
+       *
+       * This is the emergency path for a process that is about to die, and is what
+       * qlog::crash_handler calls. It only reads memory and calls @c write(2), so it is
+       * async-signal-safe: it takes no lock, allocates nothing, formats no numbers, calls no
+       * encoder, and the records stay where they are. Every sink's queue is salvaged in turn, so
+       * a record still waiting for two sinks appears twice, and so may records that a background
+       * thread is writing at that moment. Records buffered inside the sinks themselves, and
+       * pending records of other threads, are lost. The calling thread's pending records, the
+       * outermost first, are written as their raw text: their timestamp, severity and message,
+       * without their structured fields.
+       */
+      void salvage(int fd) {
+        for(auto const& route : _routes) {
+          route->salvage(fd);
+        }
+        detail::thread_records* const s = detail::thread_records::existing();
+        if(!s) {
+          return;
+        }
+        for(detail::thread_record* r = &s->first; r; r = r == s->top ? nullptr : r->inner.get()) {
+          if(!r->pending || !owns(*r)) {
+            continue;
+          }
+          if(r->encoding) {
+            // The parts an encoder would have been given, without running it.
+            detail::write_fully(fd, r->stamp, r->stamp_size);
+            detail::write_fully(fd, " [", 2);
+            detail::write_fully(fd, r->head.data(), r->name_size);
+            detail::write_fully(fd, "] ", 2);
+          }
+          detail::write_fully(fd, r->text.data(), r->text.size());
+          detail::write_fully(fd, "\n", 1);
+          r->clear();
+        }
+      }
+
+      /**
+       * @brief Sends the log's records to one more sink as well.
+       * @param[in] o Sink that receives the records. It must outlive the log.
+       * @param[in] v Only records at least this severe are written to @p o.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * Each record is formatted once and the same bytes are handed to every sink that takes its
+       * severity. The log's own verbosity still decides which records are formatted at all, so it
+       * should be at least as verbose as its most verbose sink. Add sinks before the log is used by
+       * more than one thread. For example, to write everything to a file and errors to the
+       * console as well:
+       *
+       *     qlog::logger log(log_file, qlog::all);
+       *     qlog::ostream_sink console(std::cerr);
+       *     log.add_sink(console, qlog::error);
+       */
+      logger& add_sink(sink& o, severity_t const& v) {
+        _routes.emplace_back(new detail::route(o, v.level));
+        return *this;
+      }
+
+      /**
+       * @brief Sends the log's records to one more sink, through a queue of its own.
+       * @param[in] o Sink to which records are written by a background thread of its own. It must
+       *              outlive the log.
+       * @param[in] v Only records at least this severe are written to @p o.
+       * @param[in] c Maximum number of records waiting for @p o. The queue reserves
+       *              QLOG_RECORD_SIZE bytes for each.
+       * @param[in] p What to do with a record when @p c records are already waiting.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * A slow sink with a queue of its own never holds up the other sinks of the log: only its
+       * own queue fills up, and @p p decides what happens then.
+       */
+      logger& add_sink(sink& o, severity_t const& v, std::size_t c,
+                       overflow_policy p = overflow_policy::block) {
+        _routes.emplace_back(new detail::route(o, v.level, c, p));
+        return *this;
+      }
+
+      /**
+       * @brief Sets the severity level of the calling thread's current record.
+       * @param[in] l The new logging level.
+       * @returns a reference to the @c logger object for chaining.
+       */
+      logger& set_severity(const severity_t l) {
+        detail::thread_record& r = current();
+        r.severity = l.level;
+        r.admitted = enabled(l);
+        return *this;
+      }
+
+      /**
+       * @brief Changes when finished records are written to the sink.
+       * @param[in] f The new policy.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * A synchronous log writes every record as it is finished unless it is given a policy that
+       * gathers records; an asynchronous log gathers records until its queue runs empty.
+       */
+      logger& set_flush_policy(flush_policy const& f) {
+        for(auto& route : _routes) {
+          route->set_flush_policy(f);
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Changes how records are written.
+       * @param[in] e Encoder of the records started from now on, such as a qlog::json_encoder, or
+       *              @c nullptr for the default text format. It must outlive the log.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * Without an encoder each record is formatted straight into its final text. With one, the
+       * timestamp, severity, category, message and fields are kept apart until the record is
+       * finished, and the encoder then writes them into a second buffer. For example:
+       *
+       *     static qlog::json_encoder const json;
+       *     log.set_encoder(&json);
+       *     log(qlog::info).kv("latency_us", 12) << "done";
+       *     // {"time":"2014-06-01T12:34:56.789Z","level":"INFO","message":"done","latency_us":12}
+       */
+      logger& set_encoder(encoder const* e) {
+        _encoder.store(e, std::memory_order_relaxed);
+        return *this;
+      }
+
+      /**
+       * @brief Sets the number of fractional digits in the timestamp of each record.
+       * @param[in] p The new precision.
+       * @returns a reference to the @c logger object for chaining.
+       */
+      logger& set_precision(timestamp_precision p) {
+        _precision = p;
+        return *this;
+      }
+
+      /**
+       * @brief Changes the clock that the timestamp of each record is read from.
+       * @param[in] c Clock of the records started from now on.
+       * @returns a reference to the @c logger object for chaining.
+       *
+       * The monotonic clocks cost a few nanoseconds less per record than the wall clock, and
+       * their timestamps never step backwards. The clock's anchor is taken here, which for
+       * qlog::clock_policy::tsc takes 10 milliseconds. For example:
+       *
+       *     log.set_clock(qlog::clock_policy::tsc);
+       */
+      logger& set_clock(clock_policy c) {
+        detail::anchor(c);
+        _clock.store(c, std::memory_order_relaxed);
+        return *this;
+      }
+
+      /**
+       * @brief Returns the clock that the timestamp of each record is read from.
+       */
+      clock_policy clock() const {
+        return _clock.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Writes a timestamp into a buffer without allocating memory.
+       * @param[out] b Buffer that receives the timestamp.
+       * @param[in] n Size of @p b, which should be at least qlog::timestamp_cache::max_size.
+       * @returns the length of the timestamp, or 0 if @p b is too small.
+       */
+      std::size_t timestamp(char* b, std::size_t n) {
+        return detail::this_thread_record().timestamps.format(
+                 detail::clock_time(_clock.load(std::memory_order_relaxed)), b, n, _precision);
+      }
+
+      /**
+       * @brief Returns a timestamp.
+       * @returns A @c std::string that contains a timestamp.
+       */
+      const std::string timestamp() {
+        char b[timestamp_cache::max_size];
+        return std::string(b, timestamp(b, sizeof(b)));
+      }
+
+    private:
+      /**
+       * @brief Adds a new log to the registry of live loggers.
+       */
+      void enroll() {
+        detail::registry& reg = detail::loggers();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        _id = ++reg.next_id;
+        reg.live[this] = _id;
+      }
+
+      /**
+       * @brief Returns @c true if @p r belongs to this log.
+       */
+      bool owns(detail::thread_record const& r) const {
+        return r.owner == this && r.id == _id;
+      }
+
+      /**
+       * @brief Returns the calling thread's innermost record, attaching it to this log first if
+       *        needed.
+       *
+       * A record that was pending for another log is handed to that log first, unless a
+       * qlog::record is open on it, in which case the next record up is used. Insertions that
+       * arrive before the thread has started a record on this log are treated as qlog::all.
+       */
+      detail::thread_record& current() {
+        detail::thread_records& s = detail::this_thread_records();
+        if(!owns(*s.top)) {
+          detail::thread_record& r = s.top->held ? s.push() : *s.top;
+          r.release();
+          r.owner = this;
+          r.id = _id;
+          r.severity = all.level;
+          r.admitted = all.level <= verbosity();
+          r.encoding = nullptr;
+        }
+        return *s.top;
+      }
+
+      /**
+       * @brief Finishes the calling thread's previous record and starts a new one.
+       * @param[in] l Severity of the new record.
+       * @param[in] admitted @c true if the record passed the filter of whoever started it.
+       * @param[in] category Name of the category of the record, or @c nullptr.
+       * @param[in] n Length of @p category.
+       * @returns the new record.
+       *
+       * A previous record that a qlog::record still holds is left open, and the new one is
+       * started above it.
+       */
+      detail::thread_record& start(severity_t const& l, bool admitted, char const* category,
+                                   std::size_t n) {
+        detail::thread_records& s = detail::this_thread_records();
+        if(s.top->held) {
+          s.push();
+        }
+        detail::thread_record& r = current();
+        commit(r);
+        r.severity = l.level;
+        r.admitted = admitted;
+        r.encoding = _encoder.load(std::memory_order_relaxed);
+        if(!admitted) {
+          return r;
+        }
+        struct timespec const t = detail::clock_time(_clock.load(std::memory_order_relaxed));
+        if(r.encoding) {
+          r.stamp_size = r.timestamps.format(t, r.stamp, sizeof(r.stamp), _precision);
+          r.head.append(l.name, l.name_size);
+          r.name_size = r.head.size();
+          if(category) {
+            r.head.append(category, n);
+            r.category_size = r.head.size() - r.name_size;
+          }
+          for(auto const& e : detail::this_thread_context().entries) {
+            r.add_field(e.first.data(), e.first.size(), e.second);
+          }
+        } else {
+          if(char* b = r.text.reserve(timestamp_cache::max_size)) {
+            r.text.commit(r.timestamps.format(t, b, timestamp_cache::max_size, _precision));
+          }
+          if(l.prefix_size) {
+            r.text.append(l.prefix, l.prefix_size);
+          } else {
+            r.text.append(" [", 2);
+            r.text.append(l.name, l.name_size);
+            r.text.append("] ", 2);
+          }
+          if(category) {
+            r.text.push_back('[');
+            r.text.append(category, n);
+            r.text.append("] ", 2);
+          }
+          std::string const& context = detail::this_thread_context().text;
+          r.text.append(context.data(), context.size());
+        }
+        r.pending = true;
+        return r;
+      }
+
+      /**
+       * @brief Writes or queues the record in @p r, if one is pending.
+       */
+      void commit(detail::thread_record& r) {
+        if(!r.pending) {
+          return;
+        }
+        record_buffer const& out = finish(r);
+#if QLOG_METRICS
+        detail::metric_shard& shard = _shards[detail::metric_shard_index()];
+        shard.emitted[log_metrics::slot(r.severity)].fetch_add(1, std::memory_order_relaxed);
+        shard.bytes.fetch_add(out.size(), std::memory_order_relaxed);
+#endif
+        for(auto& route : _routes) {
+          route->push(out.data(), out.size(), r.severity);
+        }
+        r.clear();
+      }
+
+      /**
+       * @brief Counts a record of level @p level that the verbosity filter turned away.
+       */
+      void count_filtered(unsigned long level) const {
+#if QLOG_METRICS && QLOG_COUNT_FILTERED
+        detail::metric_shard& shard = _shards[detail::metric_shard_index()];
+        shard.filtered[log_metrics::slot(level)].fetch_add(1, std::memory_order_relaxed);
+#else
+        (void)level;
+#endif
+      }
+
+      /**
+       * @brief Turns the pending record in @p r into the bytes the log writes.
+       * @returns the buffer that holds them.
+       */
+      static record_buffer const& finish(detail::thread_record& r) {
+        if(r.encoding) {
+          r.encoded.clear();
+          r.encoding->encode(r.view(), r.encoded);
+          r.encoded.terminate();
+          return r.encoded;
+        }
+        detail::append_logfmt(r.text, r.fields);
+        r.text.terminate();
+        return r.text;
+      }
+
+      /** @brief Sink that wraps the output stream when the log was given a stream. */
+      std::unique_ptr<sink> _stream;
+
+      /** @brief Current log verbosity level. */
+      std::atomic<unsigned long> _verbosity;
+
+      /** @brief Encoder of new records, or @c nullptr for the default text format. */
+      std::atomic<encoder const*> _encoder;
+
+      /** @brief Identifier given to the log by the registry of live loggers. */
+      unsigned long long _id;
+
+      /** @brief Number of fractional digits in the timestamp of each record. */
+      timestamp_precision _precision;
+
+      /** @brief Clock that the timestamp of each record is read from. */
+      std::atomic<clock_policy> _clock;
+
+      /**
+       * @brief Sinks that receive the log's records. The first is the one the log was created
+       *        with, and takes every record the log admits.
+       */
+      std::vector<std::unique_ptr<detail::route>> _routes;
+
+      /** @brief Record counters, one copy for each group of threads. */
+      mutable detail::metric_shard _shards[QLOG_METRIC_SHARDS];
+  };
+
+  inline record::~record() {
+    if(_log) {
+      if(_log->owns(*_record)) {
+        _log->commit(*_record);
+      }
+      _record->held = false;
+      detail::this_thread_records().pop();
+    }
+  }
+
+  template<typename T>
+  inline record& record::operator<<(T&& o) {
+    if(_record->admitted) {
+      _record->insert(std::forward<T>(o));
+      _record->pending = true;
+    }
+    return *this;
+  }
+
+  inline record& record::operator<<(std::ostream& (*p)(std::ostream&)) {
+    p(_record->stream);
+    return *this;
+  }
+
+  template<typename T>
+  inline record& record::kv(char const* key, T const& v) {
+    if(_record->admitted) {
+      _record->add_field(key, std::strlen(key), v);
+      _record->pending = true;
+    }
+    return *this;
+  }
+
+  template<typename T>
+  inline record& record::kv(std::string const& key, T const& v) {
+    if(_record->admitted) {
+      _record->add_field(key.data(), key.size(), v);
+      _record->pending = true;
+    }
+    return *this;
+  }
+
+  inline void detail::thread_record::release() {
+    if(pending && owner) {
+      registry& reg = loggers();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      auto const i = reg.live.find(owner);
+      if(i != reg.live.end() && i->second == id) {
+        owner->commit(*this);
+      }
+    }
+    clear();
+    owner = nullptr;
+  }
+
+  namespace detail {
+    /**
+     * @brief Levels set for category names, and the categories that resolve their level from
+     *        them.
+     */
+    struct category_registry {
+      /**
+       * @brief Returns the level of the most specific setting that covers @p name: its own, its
+       *        parent's (@c net for @c net.tls), and so on, and finally the setting for the empty
+       *        name. Returns QLOG_LEVEL_INHERIT if there is none.
+       */
+      unsigned long resolve(std::string name) const {
+        for(;;) {
+          auto const i = levels.find(name);
+          if(i != levels.end()) {
+            return i->second;
+          }
+          if(name.empty()) {
+            return QLOG_LEVEL_INHERIT;
+          }
+          std::size_t const dot = name.rfind('.');
+          name.resize(dot == std::string::npos ? 0 : dot);
+        }
+      }
+
+      /**
+       * @brief Resolves the level of every category again. The registry must be locked.
+       */
+      void update();
+
+      /** @brief Guards the other fields. */
+      std::mutex mutex;
+
+      /** @brief Levels set for category names. */
+      std::unordered_map<std::string, unsigned long> levels;
+
+      /** @brief Categories that exist. */
+      std::vector<category*> members;
+    };
+
+    /**
+     * @brief Returns the process's category registry, which is never destroyed, like
+     *        qlog::detail::loggers().
+     */
+    inline category_registry& categories() {
+      static category_registry* const r = new category_registry;
+      return *r;
+    }
+  }
+
+  /**
+   * @brief Named part of a program, such as @c net or @c net.tls, with a level of its own.
+   *
+   * A category writes to a qlog::logger and is used exactly like one, including with the QLOG()
+   * family of macros. Its records are filtered by the level set with qlog::set_category_level()
+   * for its name or the nearest name above it, where names are separated by dots, and by the
+   * log's own verbosity when no such level is set. The level is resolved when the category is
+   * created and again only when a setting changes, so checking a record is one load and one
+   * compare. The category's name follows the severity of each record. For example:
+   *
+   *     qlog::logger log(std::cerr, qlog::info);
+   *     static qlog::category tls(log, "net.tls");
+   *     qlog::set_category_level("net", qlog::debug);
+   *     QLOG_DEBUG(tls) << "handshake done";   // ... [DEBUG] [net.tls] handshake done
+   *
+   * A category must not outlive its log.
+   */
+  class category {
+    public:
+      /**
+       * @brief Initializes a new qlog::category and resolves its level.
+       * @param[in] l Log that receives the category's records.
+       * @param[in] name Name of the category, with dots between the levels of the hierarchy.
+       */
+      category(logger& l, std::string const& name)
+        : _log(l), _name(name), _level(QLOG_LEVEL_INHERIT) {
+        detail::category_registry& reg = detail::categories();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.members.push_back(this);
+        _level.store(reg.resolve(_name), std::memory_order_relaxed);
+      }
+
+      category(category const&) = delete;
+      category& operator=(category const&) = delete;
+
+      /**
+       * @brief Destructor. Removes the category from the registry.
+       */
+      ~category() {
+        detail::category_registry& reg = detail::categories();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for(auto i = reg.members.begin(); i != reg.members.end(); ++i) {
+          if(*i == this) {
+            reg.members.erase(i);
+            break;
+          }
+        }
+      }
+
+      /**
+       * @brief Returns the name of the category.
+       */
+      std::string const& name() const {
+        return _name;
+      }
+
+      /**
+       * @brief Returns the category's resolved level, or QLOG_LEVEL_INHERIT if it follows the
+       *        log's verbosity.
+       */
+      unsigned long level() const {
+        return _level.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Returns @c true if records of severity @p l are written for this category.
+       */
+      bool enabled(severity_t const& l) const {
+        unsigned long const v = _level.load(std::memory_order_relaxed);
+        bool const admitted = l.level <= (v == QLOG_LEVEL_INHERIT ? _log.verbosity() : v);
+        if(!admitted) {
+          _log.count_filtered(l.level);
+        }
+        return admitted;
+      }
+
+      /**
+       * @brief Counts a record that a qlog::rate_limit suppressed in the category's log.
+       */
+      void count_suppressed() {
+        _log.count_suppressed();
+      }
+
+      /**
+       * @brief Starts a record of this category. See qlog::logger::operator()().
+       * @param[in] l Severity level of the entry.
+       * @returns the new record.
+       */
+      record operator()(severity_t const& l) {
+        return record(_log, _log.start(l, enabled(l), _name.data(), _name.size()));
+      }
+
+    private:
+      friend struct detail::category_registry;
+
+      /** @brief Log that receives the category's records. */
+      logger& _log;
+
+      /** @brief Name of the category. */
+      std::string const _name;
+
+      /** @brief Resolved level, or QLOG_LEVEL_INHERIT. */
+      std::atomic<unsigned long> _level;
+  };
+
+  inline void detail::category_registry::update() {
+    for(category* c : members) {
+      c->_level.store(resolve(c->_name), std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Sets the level of a category and of every category below it that has no level of its
+   *        own.
+   * @param[in] name Name of the category, such as @c net, or the empty string for every
+   *                 category.
+   * @param[in] l Records of this severity or more severe are written.
+   */
+  inline void set_category_level(std::string const& name, severity_t const& l) {
+    detail::category_registry& reg = detail::categories();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.levels[name] = l.level;
+    reg.update();
+  }
+
+  /**
+   * @brief Removes the level set for a category, which then takes its level from above again.
+   * @param[in] name Name of the category.
+   */
+  inline void reset_category_level(std::string const& name) {
+    detail::category_registry& reg = detail::categories();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.levels.erase(name);
+    reg.update();
+  }
+
+  namespace detail {
+    /**
+     * @brief Gives both branches of the QLOG() and QLOG_AT() conditionals the type @c void.
+     *
+     * @c operator& binds more loosely than @c operator<<, so it applies to the whole chain of
+     * insertions that follows it. It accepts anything so that other kinds of log can use it.
+     */
+    struct voidify {
+      template<typename T>
+      void operator&(T&&) { }
+    };
+  }
+}
+
+/**
+ * @brief Starts a record only if the log's verbosity admits it.
+ * @param[in] log The qlog::logger to write to. It is evaluated twice.
+ * @param[in] severity The qlog::severity_t of the record.
+ *
+ * When qlog::logger::enabled() returns @c false none of the values inserted after the macro are
+ * evaluated, so expensive arguments cost nothing for a filtered record. For example:
+ *
+ *     QLOG(log, qlog::debug) << "state " << expensive_to_string(x);
+ *
+ * The expansion is a single expression, so it is safe in an unbraced @c if statement.
+ */
+#define QLOG(log, severity) \
+  !(log).enabled(severity) ? (void)0 : qlog::detail::voidify() & (log)(severity)
+
+/**
+ * @brief Starts a record whose level is known at compile time.
+ * @param[in] log The qlog::logger to write to. It is evaluated twice.
+ * @param[in] severity The qlog::severity_t of the record.
+ * @param[in] level The level of @p severity as a constant expression.
+ *
+ * When @p level is greater than QLOG_MIN_LEVEL the statement compiles to nothing. Otherwise it
+ * behaves like QLOG(), so the inserted values are only evaluated when the record is written. For
+ * example:
+ *
+ *     QLOG_AT(log, qlog::debug, QLOG_LEVEL_DEBUG) << "cache size " << cache.size();
+ */
+#define QLOG_AT(log, severity, level) \
+  !((level) <= QLOG_MIN_LEVEL && (log).enabled(severity)) \
+    ? (void)0 : qlog::detail::voidify() & (log)(severity)
+
+/** @brief Starts a qlog::fatal record. See QLOG_AT(). */
+#define QLOG_FATAL(log) QLOG_AT(log, qlog::fatal, QLOG_LEVEL_FATAL)
+
+/** @brief Starts a qlog::error record. See QLOG_AT(). */
+#define QLOG_ERROR(log) QLOG_AT(log, qlog::error, QLOG_LEVEL_ERROR)
+
+/** @brief Starts a qlog::warn record. See QLOG_AT(). */
+#define QLOG_WARN(log) QLOG_AT(log, qlog::warn, QLOG_LEVEL_WARN)
+
+/** @brief Starts a qlog::info record. See QLOG_AT(). */
+#define QLOG_INFO(log) QLOG_AT(log, qlog::info, QLOG_LEVEL_INFO)
+
+/** @brief Starts a qlog::debug record. See QLOG_AT(). */
+#define QLOG_DEBUG(log) QLOG_AT(log, qlog::debug, QLOG_LEVEL_DEBUG)
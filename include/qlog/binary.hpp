@@ -0,0 +1,777 @@
+/** @file qlog/binary.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <cstdint>
+#include <type_traits>
+
+namespace qlog {
+
+  /**
+   * @brief Static description of a place in the program that emits binary records.
+   *
+   * The QLOG_BINARY() macro creates one of these per call site, the first time the site runs.
+   * Each record refers to its site by a small identifier instead of carrying the severity itself,
+   * and the site's details are written to a stream once, ahead of the first record that needs
+   * them.
+   */
+  class binary_site {
+    public:
+      /**
+       * @brief Initializes a new qlog::binary_site and gives it a process-wide identifier.
+       * @param[in] s Severity of the records emitted by the site.
+       * @param[in] f Source file of the site.
+       * @param[in] l Source line of the site.
+       */
+      binary_site(severity_t const& s, char const* f, unsigned l)
+        : severity(s), file(f), line(l), id(next_id()), defined_for(0) {
+      }
+
+      binary_site(binary_site const&) = delete;
+      binary_site& operator=(binary_site const&) = delete;
+
+      /** @brief Severity of the records emitted by the site. */
+      severity_t const severity;
+
+      /** @brief Source file of the site. */
+      char const* const file;
+
+      /** @brief Source line of the site. */
+      unsigned const line;
+
+      /** @brief Identifier that records use to refer to the site. */
+      std::uint32_t const id;
+
+      /** @brief Identifier of the last log that has written the site's definition. */
+      mutable std::atomic<unsigned long long> defined_for;
+
+    private:
+      /**
+       * @brief Returns the next unused site identifier.
+       */
+      static std::uint32_t next_id() {
+        static std::atomic<std::uint32_t> n(0);
+        return ++n;
+      }
+  };
+
+  class binary_logger;
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Appends the raw bytes of @p v to @p b.
+     */
+    template<typename T>
+    inline void put(std::string& b, T const& v) {
+      b.append(reinterpret_cast<char const*>(&v), sizeof(v));
+    }
+
+    /**
+     * @brief Reads the raw bytes of @p v from @p b, starting at @p i.
+     * @returns @c false if @p b is too short.
+     */
+    template<typename T>
+    inline bool get(std::string const& b, std::size_t& i, T& v) {
+      if(i > b.size() || b.size() - i < sizeof(v)) {
+        return false;
+      }
+      std::memcpy(&v, b.data() + i, sizeof(v));
+      i += sizeof(v);
+      return true;
+    }
+
+    /**
+     * @brief Returns the calling thread's spare record buffer.
+     *
+     * A qlog::binary_record borrows it while it is alive, so that steady state logging reuses
+     * the same storage.
+     */
+    inline std::string& binary_scratch() {
+      return thread_instance<std::string>::get();
+    }
+  }
+
+  /**
+   * @brief Identifying bytes at the start of every binary log stream.
+   *
+   * The stream is a sequence of entries, each starting with a one byte tag:
+   *
+   * - @c Q: the remaining bytes of this header. It resets the decoder's site table, so streams
+   *   from different processes may be appended to one file.
+   * - @c D: a site definition; a @c uint32_t site identifier, the @c uint32_t severity level, the
+   *   @c uint16_t lengths of the severity name and the file name, the @c uint32_t line, and then
+   *   the two names.
+   * - @c R: a record; a @c uint32_t site identifier, the @c int64_t seconds and @c uint32_t
+   *   nanoseconds of the wall clock time, the @c uint32_t length of the arguments, and then the
+   *   arguments.
+   * - @c C: the anchor of a monotonic clock; the one byte qlog::clock_policy, the @c uint64_t raw
+   *   reading, the @c int64_t seconds and @c uint32_t nanoseconds of the wall clock time at that
+   *   reading, and the @c double nanoseconds per raw tick.
+   * - @c T: a record timed by a monotonic clock; the one byte qlog::clock_policy, a @c uint32_t
+   *   site identifier, the @c uint64_t raw reading of the clock, the @c uint32_t length of the
+   *   arguments, and then the arguments. The decoder turns the reading into wall clock time with
+   *   the last anchor of the same clock.
+   *
+   * Each argument is a one byte type tag followed by its value in native byte order: @c b bool,
+   * @c c char, @c i and @c l 32 and 64 bit signed integers, @c u and @c U 32 and 64 bit unsigned
+   * integers, @c d double, @c p pointer as a @c uint64_t, and @c s a @c uint32_t length followed
+   * by that many characters.
+   */
+  char const binary_header[] = { 'Q', 'L', 'O', 'G', 'B', 'I', 'N', '\x01' };
+
+  /**
+   * @brief A binary record that is being built.
+   *
+   * It is returned by qlog::binary_logger::operator() and written when it is destroyed, at the
+   * end of the statement that created it. Each insertion appends a type tag and the raw bytes of
+   * the value; nothing is converted to text on the logging thread except values of types that
+   * only support @c std::ostream insertion.
+   */
+  class binary_record {
+    public:
+      /**
+       * @brief Starts a record for site @p s of log @p l.
+       */
+      binary_record(binary_logger& l, binary_site const& s);
+
+      binary_record(binary_record&& r)
+        : _log(r._log), _site(r._site), _define(r._define), _anchor(r._anchor),
+          _length_at(r._length_at) {
+        _data.swap(r._data);
+        r._log = nullptr;
+      }
+
+      binary_record(binary_record const&) = delete;
+      binary_record& operator=(binary_record const&) = delete;
+
+      /**
+       * @brief Destructor. Writes the record.
+       */
+      ~binary_record();
+
+      /** @brief Records a @c bool, which is decoded as @c 1 or @c 0 like @c std::ostream does. */
+      binary_record& operator<<(bool v) {
+        tag('b');
+        detail::put(_data, static_cast<std::uint8_t>(v));
+        return *this;
+      }
+
+      /** @brief Records a single character. */
+      binary_record& operator<<(char v) {
+        tag('c');
+        _data.push_back(v);
+        return *this;
+      }
+
+      binary_record& operator<<(signed char v) {
+        return *this << static_cast<char>(v);
+      }
+
+      binary_record& operator<<(unsigned char v) {
+        return *this << static_cast<char>(v);
+      }
+
+      /** @brief Records an integer in 32 or 64 bits, depending on the width of its type. */
+      binary_record& operator<<(short v) { return integer(v); }
+      binary_record& operator<<(unsigned short v) { return integer(v); }
+      binary_record& operator<<(int v) { return integer(v); }
+      binary_record& operator<<(unsigned v) { return integer(v); }
+      binary_record& operator<<(long v) { return integer(v); }
+      binary_record& operator<<(unsigned long v) { return integer(v); }
+      binary_record& operator<<(long long v) { return integer(v); }
+      binary_record& operator<<(unsigned long long v) { return integer(v); }
+
+      /** @brief Records a floating point value as a @c double. */
+      binary_record& operator<<(double v) {
+        tag('d');
+        detail::put(_data, v);
+        return *this;
+      }
+
+      binary_record& operator<<(float v) {
+        return *this << static_cast<double>(v);
+      }
+
+      binary_record& operator<<(long double v) {
+        return *this << static_cast<double>(v);
+      }
+
+      /** @brief Records the characters of a string, or @c (null) like qlog::logger. */
+      binary_record& operator<<(char const* v) {
+        return v ? string(v, std::strlen(v)) : string("(null)", 6);
+      }
+
+      binary_record& operator<<(char* v) {
+        return *this << static_cast<char const*>(v);
+      }
+
+      binary_record& operator<<(std::string const& v) {
+        return string(v.data(), v.size());
+      }
+
+      /**
+       * @brief Records the address held by any pointer other than a string.
+       */
+      template<typename T>
+      binary_record& operator<<(T* v) {
+        tag('p');
+        detail::put(_data, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(v)));
+        return *this;
+      }
+
+      /**
+       * @brief Records a value of any other type as the text its @c std::ostream insertion
+       *        operator produces.
+       */
+      template<typename T>
+      binary_record& operator<<(T const& v) {
+        detail::thread_record& r = detail::this_thread_record();
+        std::size_t const start = r.text.size();
+        r.stream << v;
+        string(r.text.data() + start, r.text.size() - start);
+        r.text.resize(start);
+        return *this;
+      }
+
+    private:
+      friend class binary_logger;
+
+      void tag(char t) {
+        _data.push_back(t);
+      }
+
+      template<typename T>
+      binary_record& integer(T v) {
+        if(std::is_signed<T>::value) {
+          if(sizeof(T) <= 4) {
+            tag('i');
+            detail::put(_data, static_cast<std::int32_t>(v));
+          } else {
+            tag('l');
+            detail::put(_data, static_cast<std::int64_t>(v));
+          }
+        } else {
+          if(sizeof(T) <= 4) {
+            tag('u');
+            detail::put(_data, static_cast<std::uint32_t>(v));
+          } else {
+            tag('U');
+            detail::put(_data, static_cast<std::uint64_t>(v));
+          }
+        }
+        return *this;
+      }
+
+      binary_record& string(char const* s, std::size_t n) {
+        tag('s');
+        detail::put(_data, static_cast<std::uint32_t>(n));
+        _data.append(s, n);
+        return *this;
+      }
+
+      /** @brief Log that the record is written to, or @c nullptr once it has been moved from. */
+      binary_logger* _log;
+
+      /** @brief Site that emitted the record. */
+      binary_site const* _site;
+
+      /** @brief @c true when the record starts with the definition of its site. */
+      bool _define;
+
+      /** @brief Bit of the clock whose anchor precedes the record, or 0. */
+      unsigned _anchor;
+
+      /** @brief Offset of the length of the arguments within qlog::binary_record::_data. */
+      std::size_t _length_at;
+
+      /** @brief Encoded record, optionally preceded by the definition of its site. */
+      std::string _data;
+  };
+
+  /**
+   * @brief Log that writes compact binary records instead of text.
+   *
+   * The logging thread only copies a site identifier, the raw reading of the log's clock and the
+   * raw bytes of each inserted value. The stream is turned into the usual
+   * @c timestamp [LEVEL] message text later by qlog::decode() or the @c qlog-decode tool. For
+   * example:
+   *
+   *     std::ofstream log_file("trace.qlog", std::ios::app | std::ios::binary);
+   *     qlog::binary_logger log(log_file, qlog::all, 4096);
+   *     QLOG_BINARY(log, qlog::info) << "request " << id << " took " << elapsed << "us";
+   *
+   * @c std::ostream manipulators are not supported.
+   */
+  class binary_logger {
+    friend class binary_record;
+
+    public:
+      /**
+       * @brief Initializes a new synchronous qlog::binary_logger.
+       * @param[in] o Stream to which binary records are written. It should be opened in binary
+       *              mode.
+       * @param[in] v Default verbosity level of the log.
+       */
+      binary_logger(std::ostream& o, severity_t const& v = all)
+        : _stream(new ostream_sink(o)), _output(_stream.get()), _verbosity(v.level),
+          _clock(clock_policy::wall), _anchored(0), _id(next_id()) {
+        _output->write(binary_header, sizeof(binary_header));
+      }
+
+      /**
+       * @brief Initializes a new synchronous qlog::binary_logger with a sink.
+       * @param[in] o Sink to which binary records are written. It must outlive the log.
+       * @param[in] v Default verbosity level of the log.
+       */
+      binary_logger(sink& o, severity_t const& v = all)
+        : _output(&o), _verbosity(v.level), _clock(clock_policy::wall), _anchored(0),
+          _id(next_id()) {
+        _output->write(binary_header, sizeof(binary_header));
+      }
+
+      /**
+       * @brief Initializes a new asynchronous qlog::binary_logger.
+       * @param[in] o Stream to which binary records are written by a background thread.
+       * @param[in] v Default verbosity level of the log.
+       * @param[in] c Maximum number of records waiting to be written.
+       * @param[in] p What to do with a record when @p c records are already waiting.
+       *
+       * With qlog::overflow_policy::drop_oldest a site definition or clock anchor may be
+       * discarded along with the record that carried it; the decoder shows the site's later
+       * records, or their timestamps, as @c UNKNOWN.
+       */
+      binary_logger(std::ostream& o, severity_t const& v, std::size_t c,
+                    overflow_policy p = overflow_policy::block)
+        : _stream(new ostream_sink(o)), _output(_stream.get()), _verbosity(v.level),
+          _clock(clock_policy::wall), _anchored(0), _id(next_id()) {
+        _output->write(binary_header, sizeof(binary_header));
+        _writer.reset(new async_writer(*_output, c, p));
+      }
+
+      /**
+       * @brief Initializes a new asynchronous qlog::binary_logger with a sink.
+       * @param[in] o Sink to which binary records are written by a background thread. It must
+       *              outlive the log.
+       * @param[in] v Default verbosity level of the log.
+       * @param[in] c Maximum number of records waiting to be written.
+       * @param[in] p What to do with a record when @p c records are already waiting.
+       */
+      binary_logger(sink& o, severity_t const& v, std::size_t c,
+                    overflow_policy p = overflow_policy::block)
+        : _output(&o), _verbosity(v.level), _clock(clock_policy::wall), _anchored(0),
+          _id(next_id()) {
+        _output->write(binary_header, sizeof(binary_header));
+        _writer.reset(new async_writer(o, c, p));
+      }
+
+      binary_logger(binary_logger const&) = delete;
+      binary_logger& operator=(binary_logger const&) = delete;
+
+      /**
+       * @brief Destructor. An asynchronous log writes every queued record before returning.
+       */
+      ~binary_logger() {
+        flush();
+      }
+
+      /**
+       * @brief Starts a record for site @p s.
+       *
+       * The record is not filtered; use QLOG_BINARY() to check the verbosity first.
+       */
+      binary_record operator()(binary_site const& s) {
+        return binary_record(*this, s);
+      }
+
+      /**
+       * @brief Returns @c true if records of severity @p l are written to this log.
+       */
+      bool enabled(severity_t const& l) const {
+        return l.level <= _verbosity.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Changes which records are written to this log. See qlog::logger::set_verbosity().
+       * @param[in] v Records whose severity is at most as high as this are written.
+       * @returns a reference to the @c binary_logger object for chaining.
+       */
+      binary_logger& set_verbosity(severity_t const& v) {
+        _verbosity.store(v.level, std::memory_order_relaxed);
+        return *this;
+      }
+
+      /**
+       * @brief Changes the clock that the time of each record is read from.
+       * @param[in] c Clock of the records started from now on.
+       * @returns a reference to the @c binary_logger object for chaining.
+       *
+       * With a monotonic clock the logging thread only stores the raw reading, and the decoder
+       * turns it into wall clock time with an anchor that is written ahead of the first record
+       * that needs it. The anchor is taken here, which for qlog::clock_policy::tsc takes 10
+       * milliseconds. See qlog::clock_policy.
+       */
+      binary_logger& set_clock(clock_policy c) {
+        detail::anchor(c);
+        _clock.store(c, std::memory_order_relaxed);
+        return *this;
+      }
+
+      /**
+       * @brief Waits until every record emitted so far has reached the output stream.
+       */
+      binary_logger& flush() {
+        if(_writer) {
+          _writer->flush();
+        } else {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _output->flush();
+        }
+        return *this;
+      }
+
+      /**
+       * @brief Returns the number of records an asynchronous log discarded because its queue was
+       *        full.
+       */
+      unsigned long long dropped() const {
+        return _writer ? _writer->dropped() : 0;
+      }
+
+    private:
+      /**
+       * @brief Returns an identifier that no other log has.
+       */
+      static unsigned long long next_id() {
+        detail::registry& reg = detail::loggers();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        return ++reg.next_id;
+      }
+
+      /**
+       * @brief Writes or queues a finished record.
+       */
+      void commit(binary_record& r) {
+        bool written = true;
+        if(_writer) {
+          written = _writer->push(r._data.data(), r._data.size(), r._site->severity.level);
+        } else {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _output->write(r._data.data(), r._data.size());
+        }
+
+        // Only a record that is ahead of every later record may stand in for the definition.
+        if(r._define && written) {
+          r._site->defined_for.store(_id, std::memory_order_release);
+        }
+        if(r._anchor && written) {
+          _anchored.fetch_or(r._anchor, std::memory_order_release);
+        }
+      }
+
+      /** @brief Sink that wraps the output stream when the log was given a stream. */
+      std::unique_ptr<sink> _stream;
+
+      /** @brief Sink that receives binary records. */
+      sink* _output;
+
+      /** @brief Current log verbosity level. */
+      std::atomic<unsigned long> _verbosity;
+
+      /** @brief Clock that the time of each record is read from. */
+      std::atomic<clock_policy> _clock;
+
+      /** @brief One bit for each clock whose anchor has been written to the stream. */
+      std::atomic<unsigned> _anchored;
+
+      /** @brief Identifier that tells sites whether they have been defined in this stream. */
+      unsigned long long _id;
+
+      /** @brief Serializes writes to the output stream of a synchronous log. */
+      std::mutex _mutex;
+
+      /** @brief Background writer of an asynchronous log, or @c nullptr for a synchronous log. */
+      std::unique_ptr<async_writer> _writer;
+  };
+
+  inline binary_record::binary_record(binary_logger& l, binary_site const& s)
+    : _log(&l), _site(&s), _define(false), _anchor(0), _length_at(0) {
+    _data.swap(detail::binary_scratch());
+    _data.clear();
+
+    // Threads that race here may each write the definition, which the decoder tolerates.
+    if(s.defined_for.load(std::memory_order_acquire) != l._id) {
+      _define = true;
+      std::size_t const name = std::strlen(s.severity.name);
+      std::size_t const file = std::strlen(s.file);
+      _data.push_back('D');
+      detail::put(_data, s.id);
+      detail::put(_data, static_cast<std::uint32_t>(s.severity.level));
+      detail::put(_data, static_cast<std::uint16_t>(name));
+      detail::put(_data, static_cast<std::uint16_t>(file));
+      detail::put(_data, static_cast<std::uint32_t>(s.line));
+      _data.append(s.severity.name, name);
+      _data.append(s.file, file);
+    }
+
+    clock_policy const c = l._clock.load(std::memory_order_relaxed);
+    if(c == clock_policy::wall) {
+      struct timespec t;
+      clock_gettime(CLOCK_REALTIME, &t);
+      _data.push_back('R');
+      detail::put(_data, s.id);
+      detail::put(_data, static_cast<std::int64_t>(t.tv_sec));
+      detail::put(_data, static_cast<std::uint32_t>(t.tv_nsec));
+    } else {
+      // As with site definitions, the anchor rides along until a record carrying it is written.
+      detail::clock_anchor const& a = detail::anchor(c);
+      unsigned const bit = 1u << static_cast<unsigned>(c);
+      if(!(l._anchored.load(std::memory_order_acquire) & bit)) {
+        _anchor = bit;
+        _data.push_back('C');
+        detail::put(_data, static_cast<std::uint8_t>(c));
+        detail::put(_data, a.ticks);
+        detail::put(_data, a.seconds);
+        detail::put(_data, a.nanoseconds);
+        detail::put(_data, a.scale);
+      }
+      _data.push_back('T');
+      detail::put(_data, static_cast<std::uint8_t>(c));
+      detail::put(_data, s.id);
+      detail::put(_data, detail::clock_ticks(c));
+    }
+    _length_at = _data.size();
+    detail::put(_data, std::uint32_t(0));
+  }
+
+  inline binary_record::~binary_record() {
+    if(_log) {
+      std::uint32_t const n = static_cast<std::uint32_t>(_data.size() - _length_at - sizeof(n));
+      std::memcpy(&_data[_length_at], &n, sizeof(n));
+      _log->commit(*this);
+      _data.clear();
+      _data.swap(detail::binary_scratch());
+    }
+  }
+
+  /**
+   * @brief Converts a binary log stream into text.
+   * @param[in] in Stream written by a qlog::binary_logger.
+   * @param[out] out Stream that receives one @c timestamp [LEVEL] message line per record.
+   * @param[in] p Number of fractional digits in each timestamp.
+   * @returns @c false if @p in is not a binary log stream or is damaged. Everything before the
+   *          damage has been written to @p out.
+   */
+  inline bool decode(std::istream& in, std::ostream& out,
+                     timestamp_precision p = timestamp_precision::milliseconds) {
+    struct site {
+      std::string name;
+    };
+    std::unordered_map<std::uint32_t, site> sites;
+    std::size_t const clocks = static_cast<std::size_t>(clock_policy::tsc) + 1;
+    detail::clock_anchor anchors[clocks];
+    unsigned anchored = 0;
+    timestamp_cache timestamps;
+    std::string b;
+
+    // Reads exactly n bytes into b.
+    auto const read = [&in, &b](std::size_t n) {
+      b.resize(n);
+      return n == 0 || static_cast<std::size_t>(in.read(&b[0], static_cast<std::streamsize>(n))
+                                                      .gcount()) == n;
+    };
+
+    bool header = false;
+    for(;;) {
+      int const tag = in.get();
+      if(tag == std::char_traits<char>::eof()) {
+        return header;
+      }
+      std::size_t i = 0;
+      switch(tag) {
+        case 'Q': {
+          if(!read(sizeof(binary_header) - 1) ||
+             b.compare(0, b.size(), binary_header + 1, sizeof(binary_header) - 1) != 0) {
+            return false;
+          }
+          sites.clear();
+          anchored = 0;
+          header = true;
+          break;
+        }
+        case 'D': {
+          std::uint32_t id;
+          std::uint32_t level;
+          std::uint16_t name;
+          std::uint16_t file;
+          std::uint32_t line;
+          if(!header || !read(4 + 4 + 2 + 2 + 4) || !detail::get(b, i, id) ||
+             !detail::get(b, i, level) || !detail::get(b, i, name) ||
+             !detail::get(b, i, file) || !detail::get(b, i, line) ||
+             !read(std::size_t(name) + file)) {
+            return false;
+          }
+          sites[id].name.assign(b, 0, name);
+          break;
+        }
+        case 'C': {
+          std::uint8_t c;
+          detail::clock_anchor a;
+          if(!header || !read(1 + 8 + 8 + 4 + 8) || !detail::get(b, i, c) || c >= clocks ||
+             !detail::get(b, i, a.ticks) || !detail::get(b, i, a.seconds) ||
+             !detail::get(b, i, a.nanoseconds) || !detail::get(b, i, a.scale)) {
+            return false;
+          }
+          anchors[c] = a;
+          anchored |= 1u << c;
+          break;
+        }
+        case 'R':
+        case 'T': {
+          std::uint32_t id;
+          std::uint32_t n;
+          struct timespec t;
+          bool timed = true;
+          if(tag == 'R') {
+            std::int64_t seconds;
+            std::uint32_t nanoseconds;
+            if(!header || !read(4 + 8 + 4 + 4) || !detail::get(b, i, id) ||
+               !detail::get(b, i, seconds) || !detail::get(b, i, nanoseconds) ||
+               !detail::get(b, i, n) || !read(n)) {
+              return false;
+            }
+            t.tv_sec = static_cast<time_t>(seconds);
+            t.tv_nsec = static_cast<long>(nanoseconds);
+          } else {
+            std::uint8_t c;
+            std::uint64_t ticks;
+            if(!header || !read(1 + 4 + 8 + 4) || !detail::get(b, i, c) || c >= clocks ||
+               !detail::get(b, i, id) || !detail::get(b, i, ticks) || !detail::get(b, i, n) ||
+               !read(n)) {
+              return false;
+            }
+            timed = (anchored & (1u << c)) != 0;
+            if(timed) {
+              t = anchors[c].at(ticks);
+            }
+          }
+          if(timed) {
+            char ts[timestamp_cache::max_size];
+            out.write(ts, static_cast<std::streamsize>(timestamps.format(t, ts, sizeof(ts), p)));
+          } else {
+            out << "UNKNOWN";
+          }
+          auto const s = sites.find(id);
+          out << " [" << (s == sites.end() ? "UNKNOWN" : s->second.name.c_str()) << "] ";
+
+          i = 0;
+          while(i < b.size()) {
+            char const type = b[i++];
+            bool ok = true;
+            switch(type) {
+              case 'b': {
+                std::uint8_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << (v != 0);
+                }
+                break;
+              }
+              case 'c': {
+                char v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << v;
+                }
+                break;
+              }
+              case 'i': {
+                std::int32_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << v;
+                }
+                break;
+              }
+              case 'l': {
+                std::int64_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << v;
+                }
+                break;
+              }
+              case 'u': {
+                std::uint32_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << v;
+                }
+                break;
+              }
+              case 'U': {
+                std::uint64_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << v;
+                }
+                break;
+              }
+              case 'd': {
+                // The same digits as qlog::logger, rather than the stream's precision.
+                double v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  char d[32];
+                  out.write(d, static_cast<std::streamsize>(detail::format_double(d, v)));
+                }
+                break;
+              }
+              case 'p': {
+                std::uint64_t v = 0;
+                if((ok = detail::get(b, i, v))) {
+                  out << reinterpret_cast<void const*>(static_cast<std::uintptr_t>(v));
+                }
+                break;
+              }
+              case 's': {
+                std::uint32_t v;
+                ok = detail::get(b, i, v) && b.size() - i >= v;
+                if(ok) {
+                  out.write(b.data() + i, static_cast<std::streamsize>(v));
+                  i += v;
+                }
+                break;
+              }
+              default:
+                ok = false;
+            }
+            if(!ok) {
+              out << '\n';
+              return false;
+            }
+          }
+          out << '\n';
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Returns the qlog::binary_site of the call site it is expanded in.
+ * @param[in] severity Severity of the site. It must be a namespace scope qlog::severity_t such as
+ *                     qlog::info, because it is used to initialize a static object.
+ */
+#define QLOG_BINARY_SITE(severity) \
+  ([]() -> qlog::binary_site const& { \
+    static qlog::binary_site const s((severity), __FILE__, __LINE__); \
+    return s; \
+  }())
+
+/**
+ * @brief Starts a binary record if the log's verbosity admits it.
+ * @param[in] log The qlog::binary_logger to write to. It is evaluated twice.
+ * @param[in] severity Severity of the record. See QLOG_BINARY_SITE().
+ *
+ * Like QLOG(), none of the inserted values are evaluated for a filtered record.
+ */
+#define QLOG_BINARY(log, severity) \
+  !(log).enabled(severity) \
+    ? (void)0 : qlog::detail::voidify() & (log)(QLOG_BINARY_SITE(severity))
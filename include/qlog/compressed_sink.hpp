@@ -0,0 +1,159 @@
+/** @file qlog/compressed_sink.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <chrono>
+#include <zlib.h>
+
+namespace qlog {
+
+  /**
+   * @brief Sink that compresses records into gzip frames and hands each frame to another sink.
+   *
+   * Records are fed to a streaming deflate compressor as they arrive, and the compressed bytes
+   * are kept until the frame is finished: when it holds a given number of uncompressed bytes,
+   * when it is older than an interval and the sink is flushed, and when the sink is destroyed.
+   * Each frame is a complete gzip member that can be decoded on its own, and a file of frames is
+   * an ordinary gzip file that @c zcat reads from end to end. The frame is written with
+   * qlog::sink::write_block(), so a qlog::rotating_file_sink never splits one across two files.
+   * Give the sink to an asynchronous qlog::logger to keep the compression on the background
+   * thread. For example:
+   *
+   *     qlog::rotating_file_sink file("app.log.gz", 100 * 1024 * 1024);
+   *     qlog::compressed_sink gzip(file);
+   *     qlog::logger log(gzip, qlog::debug, 4096);
+   *
+   * Records in an unfinished frame are only in memory, so they are lost if the process dies, and
+   * qlog::logger::salvage() cannot recover them. Link the program with zlib (@c -lz).
+   */
+  class compressed_sink : public sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::compressed_sink.
+       * @param[in] o Sink that receives the compressed frames. It must outlive this sink.
+       * @param[in] frame_bytes Number of uncompressed bytes after which a frame is finished.
+       * @param[in] interval Age after which a frame is finished when the sink is flushed, or 0 to
+       *                     only finish frames by size.
+       * @param[in] level zlib compression level, from 1 (fastest) to 9 (smallest).
+       */
+      explicit compressed_sink(sink& o, std::size_t frame_bytes = 1 << 20,
+                               std::chrono::milliseconds interval = std::chrono::seconds(1),
+                               int level = Z_DEFAULT_COMPRESSION)
+        : _output(&o), _frame_bytes(frame_bytes ? frame_bytes : 1), _interval(interval),
+          _in(0) {
+        std::memset(&_stream, 0, sizeof(_stream));
+        // 16 more window bits ask zlib for a gzip header and trailer.
+        _ready = deflateInit2(&_stream, level, Z_DEFLATED, 15 + 16, 8,
+                              Z_DEFAULT_STRATEGY) == Z_OK;
+      }
+
+      compressed_sink(compressed_sink const&) = delete;
+      compressed_sink& operator=(compressed_sink const&) = delete;
+
+      /**
+       * @brief Destructor. Finishes and writes the last frame.
+       */
+      ~compressed_sink() {
+        if(_ready) {
+          finish();
+          deflateEnd(&_stream);
+        }
+      }
+
+      /**
+       * @brief Returns @c true if the compressor could be set up.
+       */
+      bool is_open() const {
+        return _ready;
+      }
+
+      void write(char const* d, std::size_t n) override {
+        if(!_ready || n == 0) {
+          return;
+        }
+        if(_in == 0) {
+          _started = std::chrono::steady_clock::now();
+        }
+        _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(d));
+        _stream.avail_in = static_cast<uInt>(n);
+        deflate_all(Z_NO_FLUSH);
+        _in += n;
+        if(_in >= _frame_bytes) {
+          finish();
+        }
+      }
+
+      /**
+       * @brief Finishes the current frame if it is older than the interval, and flushes the
+       *        other sink.
+       */
+      void flush() override {
+        if(_in && _interval.count() > 0 &&
+           std::chrono::steady_clock::now() - _started >= _interval) {
+          finish();
+        } else {
+          _output->flush();
+        }
+      }
+
+      /**
+       * @brief Finishes the current frame, if it has any records, writes it to the other sink,
+       *        and flushes that sink.
+       */
+      void finish() {
+        if(!_ready || _in == 0) {
+          return;
+        }
+        _stream.avail_in = 0;
+        deflate_all(Z_FINISH);
+        _output->write_block(_frame.data(), _frame.size());
+        _output->flush();
+        _frame.clear();
+        _in = 0;
+        deflateReset(&_stream);
+      }
+
+    private:
+      /**
+       * @brief Runs the compressor over its pending input and appends its output to the frame.
+       * @param[in] mode @c Z_NO_FLUSH, or @c Z_FINISH to end the frame.
+       */
+      void deflate_all(int mode) {
+        unsigned char chunk[16384];
+        for(;;) {
+          _stream.next_out = chunk;
+          _stream.avail_out = sizeof(chunk);
+          int const r = deflate(&_stream, mode);
+          _frame.append(reinterpret_cast<char const*>(chunk), sizeof(chunk) - _stream.avail_out);
+          if(r == Z_STREAM_END || r == Z_STREAM_ERROR ||
+             (mode == Z_NO_FLUSH && _stream.avail_in == 0 && _stream.avail_out != 0)) {
+            return;
+          }
+        }
+      }
+
+      /** @brief Sink that receives the compressed frames. */
+      sink* const _output;
+
+      /** @brief Number of uncompressed bytes after which a frame is finished. */
+      std::size_t const _frame_bytes;
+
+      /** @brief Age after which a frame is finished when the sink is flushed, or 0. */
+      std::chrono::milliseconds const _interval;
+
+      /** @brief State of the compressor. */
+      z_stream _stream;
+
+      /** @brief @c true if the compressor could be set up. */
+      bool _ready;
+
+      /** @brief Number of uncompressed bytes in the current frame. */
+      std::size_t _in;
+
+      /** @brief When the first record of the current frame arrived. */
+      std::chrono::steady_clock::time_point _started;
+
+      /** @brief Compressed bytes of the current frame. */
+      std::string _frame;
+  };
+}
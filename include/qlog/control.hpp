@@ -0,0 +1,314 @@
+/** @file qlog/control.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Returns the levels of the predefined severities, from the quietest to the loudest.
+     * @param[out] n Receives the number of levels.
+     */
+    inline unsigned long const* verbosity_steps(std::size_t& n) {
+      static unsigned long const steps[] = {
+        QLOG_LEVEL_NONE, QLOG_LEVEL_FATAL, QLOG_LEVEL_ERROR, QLOG_LEVEL_WARN, QLOG_LEVEL_INFO,
+        QLOG_LEVEL_DEBUG, QLOG_LEVEL_ALL
+      };
+      n = sizeof(steps) / sizeof(steps[0]);
+      return steps;
+    }
+
+    /**
+     * @brief Reads a verbosity written as the name of a predefined severity, in any case, or as a
+     *        number.
+     * @param[in] s Text to read. Leading and trailing white space is ignored.
+     * @param[out] level Receives the level.
+     * @returns @c false if @p s is neither.
+     */
+    inline bool parse_verbosity(std::string const& s, unsigned long& level) {
+      std::size_t const first = s.find_first_not_of(" \t\r\n");
+      if(first == std::string::npos) {
+        return false;
+      }
+      std::string const word = s.substr(first, s.find_first_of(" \t\r\n", first) - first);
+      severity_t const* const known[] = { &none, &fatal, &error, &warn, &info, &debug, &all };
+      for(severity_t const* k : known) {
+        if(::strcasecmp(word.c_str(), k->name) == 0) {
+          level = k->level;
+          return true;
+        }
+      }
+      char* end = nullptr;
+      unsigned long const n = std::strtoul(word.c_str(), &end, 10);
+      if(word[0] < '0' || word[0] > '9' || *end != '\0') {
+        return false;
+      }
+      level = n;
+      return true;
+    }
+  }
+
+  /**
+   * @brief Lets two signals make a log louder or quieter while the program runs.
+   *
+   * Each delivery of the louder signal moves the log's verbosity to the next predefined severity
+   * (qlog::none, qlog::fatal, qlog::error, qlog::warn, qlog::info, qlog::debug, qlog::all), and
+   * each delivery of the quieter signal moves it back. The handler only loads and stores the
+   * log's verbosity, which is async-signal-safe. Only one instance may exist at a time, and it
+   * must not outlive its log. For example:
+   *
+   *     qlog::logger log(std::cerr, qlog::info);
+   *     qlog::verbosity_signals signals(log);
+   *     // kill -USR1 <pid> now turns on debug records, and kill -USR2 <pid> turns them off again.
+   */
+  class verbosity_signals {
+    static_assert(ATOMIC_LONG_LOCK_FREE == 2 && ATOMIC_POINTER_LOCK_FREE == 2,
+                  "the signal handler needs lock-free atomics");
+
+    public:
+      /**
+       * @brief Initializes a new qlog::verbosity_signals and installs its signal handlers.
+       * @param[in] l Log whose verbosity the signals change.
+       * @param[in] louder Signal that makes the log more verbose.
+       * @param[in] quieter Signal that makes the log less verbose.
+       */
+      explicit verbosity_signals(logger& l, int louder = SIGUSR1, int quieter = SIGUSR2)
+        : _louder(louder), _quieter(quieter) {
+        target().store(&l, std::memory_order_relaxed);
+        louder_signal().store(louder, std::memory_order_relaxed);
+        struct sigaction a;
+        std::memset(&a, 0, sizeof(a));
+        a.sa_handler = &verbosity_signals::handle;
+        sigemptyset(&a.sa_mask);
+        a.sa_flags = SA_RESTART;
+        ::sigaction(louder, &a, &_previous_louder);
+        ::sigaction(quieter, &a, &_previous_quieter);
+      }
+
+      verbosity_signals(verbosity_signals const&) = delete;
+      verbosity_signals& operator=(verbosity_signals const&) = delete;
+
+      /**
+       * @brief Destructor. Puts back the handlers the signals had before.
+       */
+      ~verbosity_signals() {
+        ::sigaction(_louder, &_previous_louder, nullptr);
+        ::sigaction(_quieter, &_previous_quieter, nullptr);
+        target().store(nullptr, std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Returns the level of the first predefined severity that is louder than @p v.
+       */
+      static unsigned long louder(unsigned long v) {
+        std::size_t n;
+        unsigned long const* const steps = detail::verbosity_steps(n);
+        for(std::size_t i = 0; i < n; ++i) {
+          if(steps[i] > v) {
+            return steps[i];
+          }
+        }
+        return steps[n - 1];
+      }
+
+      /**
+       * @brief Returns the level of the first predefined severity that is quieter than @p v.
+       */
+      static unsigned long quieter(unsigned long v) {
+        std::size_t n;
+        unsigned long const* const steps = detail::verbosity_steps(n);
+        for(std::size_t i = n; i > 0; --i) {
+          if(steps[i - 1] < v) {
+            return steps[i - 1];
+          }
+        }
+        return steps[0];
+      }
+
+    private:
+      /**
+       * @brief Signal handler that steps the log's verbosity.
+       */
+      static void handle(int s) {
+        logger* const l = target().load(std::memory_order_relaxed);
+        if(l) {
+          unsigned long const v = l->verbosity();
+          l->set_verbosity(s == louder_signal().load(std::memory_order_relaxed) ? louder(v)
+                                                                                 : quieter(v));
+        }
+      }
+
+      /**
+       * @brief Returns the log that the handler changes.
+       */
+      static std::atomic<logger*>& target() {
+        static std::atomic<logger*> l(nullptr);
+        return l;
+      }
+
+      /**
+       * @brief Returns the signal that makes the log louder.
+       */
+      static std::atomic<int>& louder_signal() {
+        static std::atomic<int> s(0);
+        return s;
+      }
+
+      /** @brief Signal that makes the log more verbose. */
+      int const _louder;
+
+      /** @brief Signal that makes the log less verbose. */
+      int const _quieter;
+
+      /** @brief Handler of the louder signal before this one was installed. */
+      struct sigaction _previous_louder;
+
+      /** @brief Handler of the quieter signal before this one was installed. */
+      struct sigaction _previous_quieter;
+  };
+
+  /**
+   * @brief Sets a log's verbosity from a file, and again whenever the file changes.
+   *
+   * The file holds the name of a predefined severity, such as @c debug, or a level number. A
+   * background thread looks at the file's modification time once per interval and re-reads it
+   * when it has changed; a file that is missing or cannot be read leaves the verbosity alone. The
+   * control file must not outlive its log. For example:
+   *
+   *     qlog::logger log(std::cerr, qlog::info);
+   *     qlog::control_file control(log, "/etc/myapp/log-level");
+   *     // echo debug > /etc/myapp/log-level turns on debug records within a second.
+   */
+  class control_file {
+    public:
+      /**
+       * @brief Initializes a new qlog::control_file and reads the file once.
+       * @param[in] l Log whose verbosity the file sets.
+       * @param[in] path Name of the file.
+       * @param[in] interval How often the file is looked at, or 0 to only look when
+       *                     qlog::control_file::poll() is called.
+       */
+      control_file(logger& l, std::string const& path,
+                   std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+        : _log(l), _path(path), _interval(interval), _stop(false), _seen(false) {
+        poll();
+        if(_interval.count() > 0) {
+          _thread = std::thread(&control_file::run, this);
+        }
+      }
+
+      control_file(control_file const&) = delete;
+      control_file& operator=(control_file const&) = delete;
+
+      /**
+       * @brief Destructor. Stops the background thread.
+       */
+      ~control_file() {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _stop = true;
+          _wake.notify_one();
+        }
+        if(_thread.joinable()) {
+          _thread.join();
+        }
+      }
+
+      /**
+       * @brief Re-reads the file if it has changed since it was last read.
+       * @returns @c true if the log's verbosity was set from the file.
+       */
+      bool poll() {
+        std::lock_guard<std::mutex> lock(_polling);
+        struct stat st;
+        if(::stat(_path.c_str(), &st) != 0) {
+          _seen = false;
+          return false;
+        }
+        if(_seen && st.st_mtim.tv_sec == _stat.st_mtim.tv_sec &&
+           st.st_mtim.tv_nsec == _stat.st_mtim.tv_nsec && st.st_size == _stat.st_size &&
+           st.st_ino == _stat.st_ino) {
+          return false;
+        }
+        _stat = st;
+        _seen = true;
+
+        std::string text;
+        int const fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0) {
+          return false;
+        }
+        char b[256];
+        for(;;) {
+          ssize_t const n = ::read(fd, b, sizeof(b));
+          if(n < 0 && errno == EINTR) {
+            continue;
+          }
+          if(n <= 0 || text.size() > 4096) {
+            break;
+          }
+          text.append(b, static_cast<std::size_t>(n));
+        }
+        ::close(fd);
+
+        unsigned long level;
+        if(!detail::parse_verbosity(text, level)) {
+          return false;
+        }
+        _log.set_verbosity(level);
+        return true;
+      }
+
+    private:
+      /**
+       * @brief Body of the background thread.
+       */
+      void run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(!_wake.wait_for(lock, _interval, [this] { return _stop; })) {
+          lock.unlock();
+          poll();
+          lock.lock();
+        }
+      }
+
+      /** @brief Log whose verbosity the file sets. */
+      logger& _log;
+
+      /** @brief Name of the file. */
+      std::string const _path;
+
+      /** @brief How often the file is looked at. */
+      std::chrono::milliseconds const _interval;
+
+      /** @brief Guards qlog::control_file::_stop. */
+      std::mutex _mutex;
+
+      /** @brief Signalled when the background thread must stop. */
+      std::condition_variable _wake;
+
+      /** @brief @c true once the destructor has been called. */
+      bool _stop;
+
+      /** @brief Serializes calls to qlog::control_file::poll(). */
+      std::mutex _polling;
+
+      /** @brief @c true if qlog::control_file::_stat describes the file as it was last read. */
+      bool _seen;
+
+      /** @brief Status of the file when it was last read. */
+      struct stat _stat;
+
+      /** @brief Background thread that looks at the file. */
+      std::thread _thread;
+  };
+}
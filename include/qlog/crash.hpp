@@ -0,0 +1,120 @@
+/** @file qlog/crash.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <initializer_list>
+#include <signal.h>
+#include <unistd.h>
+
+namespace qlog {
+
+  /**
+   * @brief Writes the records a log still holds when the process dies on a fatal signal.
+   *
+   * The handler calls qlog::logger::salvage(), which writes the queued and gathered records, and
+   * the crashing thread's pending record, to a file descriptor with @c write(2). It then puts
+   * back the handler the signal had before and raises the signal again, so the process still
+   * dies, or the earlier handler still runs, as it would have. Open the file descriptor before a
+   * crash can happen; a crash file opened with @c O_APPEND, or the log file itself, both work.
+   * Only one instance may exist at a time, and it must not outlive its log. For example:
+   *
+   *     qlog::logger log(log_file, qlog::info, 4096);
+   *     qlog::crash_handler crash(log, ::open("app.log", O_WRONLY | O_APPEND | O_CLOEXEC));
+   *     log(qlog::fatal) << "giving up";
+   *     std::abort();   // "giving up" and everything queued before it is written first
+   *
+   * The handler runs on the signal stack of the crashing thread if it has one, which a stack
+   * overflow needs; see @c sigaltstack(2).
+   */
+  class crash_handler {
+    static_assert(ATOMIC_POINTER_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                  "the signal handler needs lock-free atomics");
+
+    public:
+      /**
+       * @brief Initializes a new qlog::crash_handler and installs its signal handlers.
+       * @param[in] l Log whose records are salvaged.
+       * @param[in] fd File descriptor that receives them. It is not closed by the handler.
+       * @param[in] signals Signals that are handled.
+       */
+      explicit crash_handler(logger& l, int fd = STDERR_FILENO,
+                             std::initializer_list<int> signals = { SIGSEGV, SIGBUS, SIGILL,
+                                                                    SIGFPE, SIGABRT })
+        : _count(0) {
+        target().store(&l, std::memory_order_relaxed);
+        descriptor().store(fd, std::memory_order_relaxed);
+        struct sigaction a;
+        std::memset(&a, 0, sizeof(a));
+        a.sa_handler = &crash_handler::handle;
+        sigemptyset(&a.sa_mask);
+        a.sa_flags = SA_ONSTACK;
+        for(int s : signals) {
+          if(s > 0 && s < NSIG && _count < max_signals) {
+            ::sigaction(s, &a, &previous()[s]);
+            _signals[_count++] = s;
+          }
+        }
+      }
+
+      crash_handler(crash_handler const&) = delete;
+      crash_handler& operator=(crash_handler const&) = delete;
+
+      /**
+       * @brief Destructor. Puts back the handlers the signals had before.
+       */
+      ~crash_handler() {
+        for(std::size_t i = 0; i < _count; ++i) {
+          ::sigaction(_signals[i], &previous()[_signals[i]], nullptr);
+        }
+        target().store(nullptr, std::memory_order_relaxed);
+      }
+
+    private:
+      /** @brief Largest number of signals that are handled. */
+      static const std::size_t max_signals = 16;
+
+      /**
+       * @brief Signal handler that salvages the log's records and raises the signal again.
+       */
+      static void handle(int s) {
+        static std::atomic<int> entered(0);
+        logger* const l = target().load(std::memory_order_relaxed);
+        // A second crash while salvaging goes straight to the earlier handler.
+        if(l && entered.exchange(1, std::memory_order_relaxed) == 0) {
+          l->salvage(descriptor().load(std::memory_order_relaxed));
+        }
+        ::sigaction(s, &previous()[s], nullptr);
+        ::raise(s);
+      }
+
+      /**
+       * @brief Returns the log whose records the handler salvages.
+       */
+      static std::atomic<logger*>& target() {
+        static std::atomic<logger*> l(nullptr);
+        return l;
+      }
+
+      /**
+       * @brief Returns the file descriptor that receives the salvaged records.
+       */
+      static std::atomic<int>& descriptor() {
+        static std::atomic<int> fd(STDERR_FILENO);
+        return fd;
+      }
+
+      /**
+       * @brief Returns the handlers the signals had before, by signal number.
+       */
+      static struct sigaction* previous() {
+        static struct sigaction p[NSIG];
+        return p;
+      }
+
+      /** @brief Signals that are handled. */
+      int _signals[max_signals];
+
+      /** @brief Number of signals that are handled. */
+      std::size_t _count;
+  };
+}
@@ -0,0 +1,130 @@
+/** @file qlog/global.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <functional>
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief State of the process-wide log.
+     */
+    struct global_state {
+      global_state()
+        : verbosity(all.level), capacity(0), policy(overflow_policy::block), log(nullptr) { }
+
+      /** @brief Guards creating the log and changing how it is created. */
+      std::mutex mutex;
+
+      /** @brief Creates the sink of the log, or empty for standard error. */
+      std::function<sink*()> make_sink;
+
+      /** @brief Default verbosity level of the log. */
+      unsigned long verbosity;
+
+      /** @brief Queue capacity of the log, or 0 for a synchronous log. */
+      std::size_t capacity;
+
+      /** @brief What the log does with a record when its queue is full. */
+      overflow_policy policy;
+
+      /** @brief Sink of the log, once it has been created. */
+      std::unique_ptr<sink> output;
+
+      /** @brief The log, or @c nullptr until it is first used. */
+      std::atomic<logger*> log;
+    };
+
+    /**
+     * @brief Returns the state of the process-wide log.
+     *
+     * It is created by the first caller, whichever translation unit and static initializer that
+     * is, and never destroyed, so static destructors may still log.
+     */
+    inline global_state& global() {
+      static global_state* const s = new global_state;
+      return *s;
+    }
+  }
+
+  /**
+   * @brief Changes how the process-wide log returned by qlog::global_logger() is created.
+   * @param[in] make Creates the sink of the log when it is first used. The log owns the sink. An
+   *                 empty function writes to standard error.
+   * @param[in] v Default verbosity level of the log.
+   * @param[in] c Maximum number of records waiting to be written, or 0 for a synchronous log.
+   * @param[in] p What to do with a record when @p c records are already waiting.
+   * @returns @c false, and changes nothing, if the log has already been created.
+   *
+   * Nothing is opened, started or allocated until the log is first used. For example:
+   *
+   *     qlog::configure_global_logger(
+   *         [] { return new qlog::rotating_file_sink("app.log", 100 * 1024 * 1024); },
+   *         qlog::info, 4096);
+   */
+  inline bool configure_global_logger(std::function<sink*()> make, severity_t const& v = all,
+                                      std::size_t c = 0,
+                                      overflow_policy p = overflow_policy::block) {
+    detail::global_state& g = detail::global();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if(g.log.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    g.make_sink = std::move(make);
+    g.verbosity = v.level;
+    g.capacity = c;
+    g.policy = p;
+    return true;
+  }
+
+  inline void shutdown();
+
+  /**
+   * @brief Returns the process-wide log, creating it, its sink and its background thread on the
+   *        first call.
+   *
+   * Any thread may call this at any time, including from static initializers and destructors in
+   * any translation unit. Once created the log is never destroyed; call qlog::shutdown() before
+   * the program exits to write the records it still holds. For example:
+   *
+   *     QLOG_INFO(qlog::global_logger()) << "starting";
+   */
+  inline logger& global_logger() {
+    detail::global_state& g = detail::global();
+    logger* l = g.log.load(std::memory_order_acquire);
+    if(l) {
+      return *l;
+    }
+    std::lock_guard<std::mutex> lock(g.mutex);
+    l = g.log.load(std::memory_order_relaxed);
+    if(!l) {
+      g.output.reset(g.make_sink ? g.make_sink() : nullptr);
+      if(!g.output) {
+        g.output.reset(new ostream_sink(std::cerr));
+      }
+      l = g.capacity ? new logger(*g.output, all, g.capacity, g.policy)
+                     : new logger(*g.output, all);
+      l->set_verbosity(g.verbosity);
+      g.log.store(l, std::memory_order_release);
+      // A safety net for programs that return from main() without calling shutdown().
+      std::atexit(shutdown);
+    }
+    return *l;
+  }
+
+  /**
+   * @brief Writes every record the process-wide log holds and stops its background thread.
+   *
+   * Call it at the end of @c main(), before static destruction begins. Records written to the
+   * log afterwards go straight to its sink on the thread that wrote them. It does nothing if the
+   * log was never used, and it is also run by @c std::atexit.
+   */
+  inline void shutdown() {
+    logger* const l = detail::global().log.load(std::memory_order_acquire);
+    if(l) {
+      l->shutdown();
+    }
+  }
+}
@@ -0,0 +1,65 @@
+/** @file qlog/metrics.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <ostream>
+
+namespace qlog {
+
+  /**
+   * @brief Writes a log's counters in the Prometheus text exposition format.
+   * @param[out] o Stream that receives the metrics, such as the body of a @c /metrics response.
+   * @param[in] m Counters returned by qlog::logger::metrics().
+   * @param[in] prefix Start of the name of every metric.
+   *
+   * The metrics are @c <prefix>_records_total and @c <prefix>_filtered_total, which stays 0
+   * unless QLOG_COUNT_FILTERED is set, with a @c level label, @c <prefix>_bytes_total,
+   * @c <prefix>_dropped_total, @c <prefix>_suppressed_total, the gauge
+   * @c <prefix>_queue_high_water, and the histogram @c <prefix>_sink_write_seconds. For example:
+   *
+   *     std::ostringstream body;
+   *     qlog::write_prometheus(body, log.metrics(), "myapp_log");
+   */
+  inline void write_prometheus(std::ostream& o, log_metrics const& m,
+                               std::string const& prefix = "qlog") {
+    // Writes the HELP and TYPE lines of one metric.
+    auto const head = [&o, &prefix](char const* name, char const* type, char const* help) {
+      o << "# HELP " << prefix << '_' << name << ' ' << help << '\n'
+        << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+    };
+
+    head("records_total", "counter", "Records finished, by severity.");
+    for(std::size_t i = 0; i < log_metrics::levels; ++i) {
+      o << prefix << "_records_total{level=\"" << log_metrics::slot_name(i) << "\"} "
+        << m.emitted[i] << '\n';
+    }
+    head("filtered_total", "counter", "Records turned away by the verbosity, by severity.");
+    for(std::size_t i = 0; i < log_metrics::levels; ++i) {
+      o << prefix << "_filtered_total{level=\"" << log_metrics::slot_name(i) << "\"} "
+        << m.filtered[i] << '\n';
+    }
+    head("bytes_total", "counter", "Bytes of the finished records.");
+    o << prefix << "_bytes_total " << m.bytes << '\n';
+    head("dropped_total", "counter", "Records discarded because a queue was full.");
+    o << prefix << "_dropped_total " << m.dropped << '\n';
+    head("suppressed_total", "counter", "Records suppressed by rate limits.");
+    o << prefix << "_suppressed_total " << m.suppressed << '\n';
+    head("queue_high_water", "gauge", "Most records that waited at once in one queue.");
+    o << prefix << "_queue_high_water " << m.queue_high_water << '\n';
+
+    head("sink_write_seconds", "histogram", "Time taken by each write to a sink.");
+    unsigned long long n = 0;
+    for(std::size_t i = 0; i < log_metrics::buckets; ++i) {
+      n += m.latency[i];
+      o << prefix << "_sink_write_seconds_bucket{le=\"";
+      if(i + 1 < log_metrics::buckets) {
+        o << static_cast<double>(log_metrics::bucket_bound(i)) / 1e9;
+      } else {
+        o << "+Inf";
+      }
+      o << "\"} " << n << '\n';
+    }
+    o << prefix << "_sink_write_seconds_sum " << static_cast<double>(m.write_nanoseconds) / 1e9
+      << '\n' << prefix << "_sink_write_seconds_count " << m.writes << '\n';
+  }
+}
@@ -0,0 +1,224 @@
+/** @file qlog/mmap_sink.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qlog {
+
+  /**
+   * @brief When a qlog::mmap_sink asks the kernel to write its mapping back to the file.
+   */
+  enum class msync_policy {
+    /** @brief Never; the page cache writes the data back in its own time. This is the default. */
+    none,
+
+    /** @brief Schedule the write back, with @c MS_ASYNC, on every flush and chunk change. */
+    async,
+
+    /** @brief Wait for the write back, with @c MS_SYNC, on every flush and chunk change. */
+    sync
+  };
+
+  /**
+   * @brief Sink that copies records straight into a memory mapping of the log file.
+   *
+   * The file is extended and mapped one chunk at a time, and each record is a single @c memcpy
+   * into the mapping, with no stream or system call in between. Records that have been copied are
+   * in the page cache, so they survive a crash of the process even if they were never flushed.
+   *
+   * While the sink is open the file is longer than its contents and ends in zero bytes. The
+   * destructor truncates it to its contents; after a crash, the next qlog::mmap_sink opened on the
+   * file finds the end of the contents and continues from there. For example:
+   *
+   *     qlog::mmap_sink file("app.log");
+   *     qlog::logger log(file, qlog::info, 4096);
+   */
+  class mmap_sink : public sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::mmap_sink and opens, or appends to, its file.
+       * @param[in] path Name of the file.
+       * @param[in] chunk Number of bytes by which the file is extended and mapped at a time. It is
+       *                  rounded up to a multiple of the page size.
+       * @param[in] p When to write the mapping back to the file.
+       */
+      explicit mmap_sink(std::string const& path, std::size_t chunk = 1 << 20,
+                         msync_policy p = msync_policy::none)
+        : _chunk(round_up(chunk ? chunk : 1, page_size())), _policy(p), _fd(-1), _base(0),
+          _map(nullptr), _offset(0), _synced(0) {
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st;
+        if(_fd < 0 || ::fstat(_fd, &st) != 0) {
+          return;
+        }
+        std::size_t const size = contents(static_cast<std::size_t>(st.st_size));
+        std::size_t const base = size / page_size() * page_size();
+        if(map(base)) {
+          _offset = size - base;
+          _synced = _offset;
+        }
+      }
+
+      mmap_sink(mmap_sink const&) = delete;
+      mmap_sink& operator=(mmap_sink const&) = delete;
+
+      /**
+       * @brief Destructor. Unmaps the file and truncates it to its contents.
+       */
+      ~mmap_sink() {
+        if(_map) {
+          sync(_policy == msync_policy::none ? msync_policy::none : msync_policy::sync);
+          ::munmap(_map, _chunk);
+          if(::ftruncate(_fd, static_cast<off_t>(_base + _offset)) != 0) {
+            // The file keeps its trailing zero bytes, which the next sink skips.
+          }
+        }
+        if(_fd >= 0) {
+          ::close(_fd);
+        }
+      }
+
+      /**
+       * @brief Returns @c true if the file could be opened and mapped.
+       */
+      bool is_open() const {
+        return _map != nullptr;
+      }
+
+      /**
+       * @brief Returns the number of bytes of records in the file.
+       */
+      std::size_t size() const {
+        return _base + _offset;
+      }
+
+      void write(char const* d, std::size_t n) override {
+        while(n > 0 && _map) {
+          if(_offset == _chunk) {
+            sync(_policy);
+            ::munmap(_map, _chunk);
+            _map = nullptr;
+            if(!map(_base + _chunk)) {
+              return;
+            }
+            _offset = 0;
+            _synced = 0;
+          }
+          std::size_t const c = n < _chunk - _offset ? n : _chunk - _offset;
+          std::memcpy(_map + _offset, d, c);
+          _offset += c;
+          d += c;
+          n -= c;
+        }
+      }
+
+      void flush() override {
+        sync(_policy);
+      }
+
+    private:
+      /**
+       * @brief Returns the size of a page of memory.
+       */
+      static std::size_t page_size() {
+        static std::size_t const n = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return n;
+      }
+
+      /**
+       * @brief Returns @p n rounded up to a multiple of @p m.
+       */
+      static std::size_t round_up(std::size_t n, std::size_t m) {
+        return (n + m - 1) / m * m;
+      }
+
+      /**
+       * @brief Returns the length of the records in a file of @p size bytes.
+       *
+       * A writer that crashed leaves the file a whole number of pages long, with zero bytes after
+       * the last record it copied. Those are skipped. A file that was closed cleanly is returned
+       * whole, unless its length happens to be a multiple of the page size and it ends in zero
+       * bytes, which text logs never do.
+       */
+      std::size_t contents(std::size_t size) const {
+        if(size % page_size() != 0) {
+          return size;
+        }
+        char b[4096];
+        while(size > 0) {
+          std::size_t const n = size < sizeof(b) ? size : sizeof(b);
+          if(::pread(_fd, b, n, static_cast<off_t>(size - n)) != static_cast<ssize_t>(n)) {
+            return size;
+          }
+          for(std::size_t i = n; i > 0; --i) {
+            if(b[i - 1] != '\0') {
+              return size - n + i;
+            }
+          }
+          size -= n;
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Extends the file to cover the chunk at @p base and maps it.
+       * @returns @c false if the file could not be extended or mapped.
+       */
+      bool map(std::size_t base) {
+        struct stat st;
+        if(::fstat(_fd, &st) != 0) {
+          return false;
+        }
+        off_t const end = static_cast<off_t>(base + _chunk);
+        if(st.st_size < end && ::ftruncate(_fd, end) != 0) {
+          return false;
+        }
+        void* const m = ::mmap(nullptr, _chunk, PROT_READ | PROT_WRITE, MAP_SHARED, _fd,
+                               static_cast<off_t>(base));
+        if(m == MAP_FAILED) {
+          return false;
+        }
+        ::madvise(m, _chunk, MADV_SEQUENTIAL);
+        _map = static_cast<char*>(m);
+        _base = base;
+        return true;
+      }
+
+      /**
+       * @brief Writes back the pages copied to since the last call, according to @p p.
+       */
+      void sync(msync_policy p) {
+        if(p == msync_policy::none || !_map || _synced == _offset) {
+          return;
+        }
+        std::size_t const start = _synced / page_size() * page_size();
+        ::msync(_map + start, _offset - start, p == msync_policy::sync ? MS_SYNC : MS_ASYNC);
+        _synced = _offset;
+      }
+
+      /** @brief Size of a chunk. */
+      std::size_t const _chunk;
+
+      /** @brief When to write the mapping back to the file. */
+      msync_policy const _policy;
+
+      /** @brief Descriptor of the file, or -1 if it could not be opened. */
+      int _fd;
+
+      /** @brief Offset in the file of the mapped chunk. */
+      std::size_t _base;
+
+      /** @brief Mapping of the current chunk, or @c nullptr. */
+      char* _map;
+
+      /** @brief Offset in the chunk of the end of the records. */
+      std::size_t _offset;
+
+      /** @brief Offset in the chunk up to which the mapping has been written back. */
+      std::size_t _synced;
+  };
+}
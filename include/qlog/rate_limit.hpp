@@ -0,0 +1,204 @@
+/** @file qlog/rate_limit.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <chrono>
+
+/**
+ * @brief Default time, in milliseconds, between the summaries of a rate limited call site.
+ *
+ * Define it before including qlog/rate_limit.hpp to change it.
+ */
+#ifndef QLOG_SUMMARY_INTERVAL
+#define QLOG_SUMMARY_INTERVAL 1000
+#endif
+
+namespace qlog {
+
+  /**
+   * @brief Token bucket that limits how often one call site writes records.
+   *
+   * A site admits records at a steady rate, and lets a burst of records through at once after a
+   * quiet period. The bucket is a single atomic holding the time at which it will next be full
+   * (the generic cell rate algorithm), so admitting a record never takes a lock. Records that are
+   * turned away are counted, and once per summary interval the site writes a record of its own
+   * that says how many it suppressed. The summary is written by the first call at the site after
+   * the interval has passed. Use it through QLOG_LIMIT() rather than directly.
+   */
+  class rate_limit {
+    public:
+      /**
+       * @brief Initializes a new qlog::rate_limit with a full bucket.
+       * @param[in] per_second Number of records admitted per second in the long run. A rate of
+       *                       0 or less only admits the first burst.
+       * @param[in] burst Number of records admitted at once after a quiet period; at least 1.
+       * @param[in] summary Least time between two summaries of suppressed records.
+       * @param[in] file Source file of the call site, named in summaries, or @c nullptr.
+       * @param[in] line Source line of the call site.
+       */
+      rate_limit(double per_second, unsigned burst, std::chrono::milliseconds summary,
+                 char const* file = nullptr, unsigned line = 0)
+        : _interval(interval_for(per_second, burst)),
+          _tolerance(_interval * (burst ? burst - 1 : 0)),
+          _summary(std::chrono::duration_cast<std::chrono::nanoseconds>(summary).count()),
+          _file(file), _line(line), _full(now()), _suppressed(0), _reported(now()) {
+      }
+
+      rate_limit(rate_limit const&) = delete;
+      rate_limit& operator=(rate_limit const&) = delete;
+
+      /**
+       * @brief Decides whether the site may write a record now, and writes a summary if one is
+       *        due.
+       * @param[in] log qlog::logger, or anything used like one, that receives the summary and
+       *                counts the suppressed records.
+       * @param[in] s Severity of the record, which the summary shares.
+       * @returns @c true if the record may be written.
+       */
+      template<typename Log>
+      bool admit(Log& log, severity_t const& s) {
+        std::int64_t const t = now();
+        bool const admitted = take(t);
+        if(!admitted) {
+          _suppressed.fetch_add(1, std::memory_order_relaxed);
+          log.count_suppressed();
+        }
+        report(log, s, t);
+        return admitted;
+      }
+
+      /**
+       * @brief Returns the number of records suppressed since the last summary.
+       */
+      unsigned long long suppressed() const {
+        return _suppressed.load(std::memory_order_relaxed);
+      }
+
+    private:
+      /**
+       * @brief Returns the nanoseconds between two tokens at @p per_second.
+       *
+       * It is capped so that a whole burst of intervals still fits well within an
+       * @c std::int64_t of nanoseconds: about 73 years, which is also what a rate of 0 or less,
+       * or one too small to represent, gets.
+       */
+      static std::int64_t interval_for(double per_second, unsigned burst) {
+        std::int64_t const most = INT64_MAX / 4 / (burst ? burst : 1);
+        if(!(per_second > 0) || 1e9 / per_second >= static_cast<double>(most)) {
+          return most;
+        }
+        return static_cast<std::int64_t>(1e9 / per_second);
+      }
+
+      /**
+       * @brief Returns the current time in nanoseconds.
+       */
+      static std::int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      /**
+       * @brief Takes a token from the bucket at time @p t.
+       * @returns @c false if the bucket is empty.
+       */
+      bool take(std::int64_t t) {
+        std::int64_t full = _full.load(std::memory_order_relaxed);
+        for(;;) {
+          std::int64_t const start = full > t ? full : t;
+          if(start - t > _tolerance) {
+            return false;
+          }
+          if(_full.compare_exchange_weak(full, start + _interval, std::memory_order_relaxed)) {
+            return true;
+          }
+        }
+      }
+
+      /**
+       * @brief Writes a summary of the suppressed records if one is due at time @p t.
+       */
+      template<typename Log>
+      void report(Log& log, severity_t const& s, std::int64_t t) {
+        if(_suppressed.load(std::memory_order_relaxed) == 0) {
+          return;
+        }
+        std::int64_t last = _reported.load(std::memory_order_relaxed);
+        if(t - last < _summary ||
+           !_reported.compare_exchange_strong(last, t, std::memory_order_relaxed)) {
+          return;
+        }
+        unsigned long long const n = _suppressed.exchange(0, std::memory_order_relaxed);
+        if(n) {
+          record r = log(s);
+          r << "suppressed " << n << " similar messages";
+          if(_file) {
+            r << " from " << _file << ':' << _line;
+          }
+        }
+      }
+
+      /** @brief Nanoseconds between two tokens. */
+      std::int64_t const _interval;
+
+      /** @brief Nanoseconds by which a burst may run ahead of the steady rate. */
+      std::int64_t const _tolerance;
+
+      /** @brief Least nanoseconds between two summaries. */
+      std::int64_t const _summary;
+
+      /** @brief Source file of the call site, or @c nullptr. */
+      char const* const _file;
+
+      /** @brief Source line of the call site. */
+      unsigned const _line;
+
+      /** @brief Time at which the bucket has no tokens left to give. */
+      std::atomic<std::int64_t> _full;
+
+      /** @brief Number of records suppressed since the last summary. */
+      std::atomic<unsigned long long> _suppressed;
+
+      /** @brief Time of the last summary. */
+      std::atomic<std::int64_t> _reported;
+  };
+}
+
+/**
+ * @brief Returns the qlog::rate_limit of the call site where it is expanded.
+ * @param[in] per_second Constant number of records admitted per second.
+ * @param[in] burst Constant number of records admitted at once.
+ * @param[in] summary Constant @c std::chrono::milliseconds between summaries.
+ */
+#define QLOG_RATE_LIMIT_SITE(per_second, burst, summary) \
+  ([]() -> qlog::rate_limit& { \
+    static qlog::rate_limit s((per_second), (burst), (summary), __FILE__, __LINE__); \
+    return s; \
+  }())
+
+/**
+ * @brief Starts a record if the log's verbosity admits it and the call site is within its rate.
+ * @param[in] log The qlog::logger or qlog::category to write to. It is evaluated more than once.
+ * @param[in] severity The qlog::severity_t of the record.
+ * @param[in] per_second Constant number of records the site writes per second in the long run.
+ * @param[in] burst Constant number of records the site writes at once after a quiet period.
+ * @param[in] summary Constant @c std::chrono::milliseconds between summaries of the suppressed
+ *                    records.
+ *
+ * Like QLOG(), none of the inserted values are evaluated for a record that is turned away. For
+ * example, to write at most 10 records per second, and 100 at once, from a hot error path:
+ *
+ *     QLOG_LIMIT_SUMMARY(log, qlog::error, 10, 100, std::chrono::seconds(10))
+ *         << "connect failed: " << strerror(errno);
+ */
+#define QLOG_LIMIT_SUMMARY(log, severity, per_second, burst, summary) \
+  !((log).enabled(severity) && \
+    QLOG_RATE_LIMIT_SITE(per_second, burst, summary).admit((log), (severity))) \
+    ? (void)0 : qlog::detail::voidify() & (log)(severity)
+
+/**
+ * @brief QLOG_LIMIT_SUMMARY() with a summary every QLOG_SUMMARY_INTERVAL milliseconds.
+ */
+#define QLOG_LIMIT(log, severity, per_second, burst) \
+  QLOG_LIMIT_SUMMARY(log, severity, per_second, burst, \
+                     std::chrono::milliseconds(QLOG_SUMMARY_INTERVAL))
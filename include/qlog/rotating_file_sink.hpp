@@ -0,0 +1,203 @@
+/** @file qlog/rotating_file_sink.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qlog {
+
+  /**
+   * @brief Sink that writes to a file and ages it by size, by time, or both.
+   *
+   * When the file would grow past its size limit, or has been open for longer than its interval,
+   * it is closed and renamed with a @c .1 suffix, older archives move up by one (@c .1 becomes
+   * @c .2 and so on), the oldest archive beyond the limit is deleted, and a new file is opened.
+   * Rotation only happens between records, so a batch of records that would overflow the file is
+   * split at the last record that fits. Give the sink to an asynchronous qlog::logger to keep the
+   * renames and reopens on the background thread. For example:
+   *
+   *     qlog::rotating_file_sink file("app.log", 10 * 1024 * 1024, std::chrono::hours(24), 7);
+   *     qlog::logger log(file, qlog::info, 4096);
+   */
+  class rotating_file_sink : public sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::rotating_file_sink and opens, or appends to, its file.
+       * @param[in] path Name of the file.
+       * @param[in] max_bytes Largest size of a file, or 0 to never rotate by size. A single record
+       *                      that is larger than this is written to a file of its own.
+       * @param[in] interval Longest time a file is kept open, or 0 to never rotate by time.
+       * @param[in] max_files Number of archived files to keep.
+       */
+      rotating_file_sink(std::string const& path, std::size_t max_bytes,
+                         std::chrono::milliseconds interval = std::chrono::milliseconds(0),
+                         unsigned max_files = 5)
+        : _path(path), _max_bytes(max_bytes), _interval(interval), _max_files(max_files),
+          _fd(-1), _size(0) {
+        open(O_APPEND);
+      }
+
+      rotating_file_sink(rotating_file_sink const&) = delete;
+      rotating_file_sink& operator=(rotating_file_sink const&) = delete;
+
+      /**
+       * @brief Destructor. Closes the file.
+       */
+      ~rotating_file_sink() {
+        if(_fd >= 0) {
+          ::close(_fd);
+        }
+      }
+
+      /**
+       * @brief Returns @c true if the current file could be opened.
+       */
+      bool is_open() const {
+        return _fd >= 0;
+      }
+
+      /**
+       * @brief Returns the name of archived file @p n, where 1 is the newest.
+       */
+      std::string archive(unsigned n) const {
+        return _path + "." + std::to_string(n);
+      }
+
+      void write(char const* d, std::size_t n) override {
+        if(expired()) {
+          rotate();
+        }
+        while(n > 0 && _fd >= 0) {
+          std::size_t c = n;
+          if(_max_bytes && _size + n > _max_bytes) {
+            c = fitting(d, n, _size < _max_bytes ? _max_bytes - _size : 0);
+            if(c == 0) {
+              if(_size) {
+                rotate();
+                continue;
+              }
+              char const* const end = static_cast<char const*>(std::memchr(d, '\n', n));
+              c = end ? static_cast<std::size_t>(end - d) + 1 : n;
+            }
+          }
+          put(d, c);
+          d += c;
+          n -= c;
+        }
+      }
+
+      /**
+       * @brief Writes a block whole, rotating first if it would overflow a file that already has
+       *        something in it.
+       */
+      void write_block(char const* d, std::size_t n) override {
+        if(expired() || (_max_bytes && _size && _size + n > _max_bytes)) {
+          rotate();
+        }
+        put(d, n);
+      }
+
+      /**
+       * @brief Closes the current file, archives it, and opens a new one.
+       */
+      void rotate() {
+        if(_fd >= 0) {
+          ::close(_fd);
+          _fd = -1;
+        }
+        if(_max_files == 0) {
+          std::remove(_path.c_str());
+        } else {
+          std::remove(archive(_max_files).c_str());
+          for(unsigned i = _max_files; i > 1; --i) {
+            std::rename(archive(i - 1).c_str(), archive(i).c_str());
+          }
+          std::rename(_path.c_str(), archive(1).c_str());
+        }
+        open(O_TRUNC);
+      }
+
+    private:
+      /**
+       * @brief Returns @c true if the file has been open for longer than its interval.
+       */
+      bool expired() const {
+        return _interval.count() > 0 && std::chrono::steady_clock::now() - _opened >= _interval;
+      }
+
+      /**
+       * @brief Returns the length of the whole records at the start of @p d that fit in @p room
+       *        bytes.
+       * @param[in] d First byte of one or more records.
+       * @param[in] n Number of bytes at @p d.
+       * @param[in] room Number of bytes left in the current file.
+       */
+      static std::size_t fitting(char const* d, std::size_t n, std::size_t room) {
+        for(std::size_t i = room < n ? room : n; i > 0; --i) {
+          if(d[i - 1] == '\n') {
+            return i;
+          }
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Writes @p n bytes to the current file.
+       */
+      void put(char const* d, std::size_t n) {
+        while(n > 0 && _fd >= 0) {
+          ssize_t const w = ::write(_fd, d, n);
+          if(w < 0) {
+            if(errno == EINTR) {
+              continue;
+            }
+            return;
+          }
+          d += w;
+          n -= static_cast<std::size_t>(w);
+          _size += static_cast<std::size_t>(w);
+        }
+      }
+
+      /**
+       * @brief Opens the file and learns its current size.
+       * @param[in] mode @c O_APPEND or @c O_TRUNC.
+       */
+      void open(int mode) {
+        _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | mode, 0644);
+        _size = 0;
+        struct stat st;
+        if(_fd >= 0 && ::fstat(_fd, &st) == 0) {
+          _size = static_cast<std::size_t>(st.st_size);
+        }
+        _opened = std::chrono::steady_clock::now();
+      }
+
+      /** @brief Name of the current file. */
+      std::string const _path;
+
+      /** @brief Largest size of a file, or 0. */
+      std::size_t const _max_bytes;
+
+      /** @brief Longest time a file is kept open, or 0. */
+      std::chrono::milliseconds const _interval;
+
+      /** @brief Number of archived files to keep. */
+      unsigned const _max_files;
+
+      /** @brief Descriptor of the current file, or -1 if it could not be opened. */
+      int _fd;
+
+      /** @brief Size of the current file. */
+      std::size_t _size;
+
+      /** @brief When the current file was opened. */
+      std::chrono::steady_clock::time_point _opened;
+  };
+}
@@ -0,0 +1,133 @@
+/** @file qlog/sample.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <chrono>
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Scrambles the bits of @p x (the finalizer of SplitMix64).
+     */
+    inline std::uint64_t mix(std::uint64_t x) {
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+
+    /**
+     * @brief Returns a pseudo-random number from the calling thread's generator.
+     */
+    inline std::uint64_t random() {
+      static thread_local std::uint64_t state =
+        mix(static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())
+            ^ reinterpret_cast<std::uintptr_t>(&state));
+      state += 0x9e3779b97f4a7c15ULL;
+      return mix(state);
+    }
+  }
+
+  /**
+   * @brief Keeps the first of every @p n records counted by @p counter.
+   * @param[in,out] counter Per-site, per-thread count of records; see QLOG_SAMPLE_EVERY().
+   * @param[in] n Sampling rate. 0 and 1 keep every record.
+   */
+  inline bool sample_every(unsigned long& counter, unsigned long n) {
+    bool const keep = counter == 0;
+    if(++counter >= n) {
+      counter = 0;
+    }
+    return keep;
+  }
+
+  /**
+   * @brief Keeps a record with probability @p p.
+   */
+  inline bool sample_chance(double p) {
+    return p >= 1 || (p > 0 && static_cast<double>(detail::random() >> 11) <
+                               p * 9007199254740992.0);
+  }
+
+  /**
+   * @brief Keeps the records of one key in every @p n, and always the same keys.
+   * @param[in] key Identifier, such as a request ID, shared by records that belong together.
+   * @param[in] n Sampling rate. 0 and 1 keep every record.
+   *
+   * The decision depends only on @p key and @p n, so every record of a kept request is kept, at
+   * every call site, on every thread and in every process.
+   */
+  inline bool sample_key(std::uint64_t key, unsigned long n) {
+    return n <= 1 || detail::mix(key) % n == 0;
+  }
+
+  /**
+   * @brief Keeps the records of one key in every @p n. See qlog::sample_key().
+   */
+  inline bool sample_key(std::string const& key, unsigned long n) {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for(char c : key) {
+      h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return sample_key(h, n);
+  }
+}
+
+/**
+ * @brief Returns the calling thread's record count at the call site where it is expanded.
+ */
+#define QLOG_SAMPLE_COUNTER() \
+  ([]() -> unsigned long& { \
+    static thread_local unsigned long n = 0; \
+    return n; \
+  }())
+
+/**
+ * @brief Starts a record if the log's verbosity admits it and @p keep is @c true.
+ * @param[in] log The qlog::logger or qlog::category to write to. It is evaluated twice.
+ * @param[in] severity The qlog::severity_t of the record.
+ * @param[in] keep Sampling decision. It is only evaluated if the verbosity admits the record.
+ *
+ * None of the inserted values are evaluated for a record that is not kept.
+ */
+#define QLOG_SAMPLE_IF(log, severity, keep) \
+  !((log).enabled(severity) && (keep)) ? (void)0 : qlog::detail::voidify() & (log)(severity)
+
+/**
+ * @brief Keeps the first of every @p n records from the call site on each thread.
+ *
+ * For example, to leave debug logging on in production at one record in a thousand:
+ *
+ *     QLOG_SAMPLE_EVERY(log, qlog::debug, 1000) << "cache miss for " << key;
+ */
+#define QLOG_SAMPLE_EVERY(log, severity, n) \
+  QLOG_SAMPLE_IF(log, severity, qlog::sample_every(QLOG_SAMPLE_COUNTER(), (n)))
+
+/**
+ * @brief Keeps records from the call site at the default rate of their severity.
+ *
+ * For example:
+ *
+ *     qlog::severity_t const trace(QLOG_LEVEL_DEBUG, "TRACE", 1000);
+ *     QLOG_SAMPLE(log, trace) << "cache miss for " << key;
+ */
+#define QLOG_SAMPLE(log, severity) \
+  QLOG_SAMPLE_EVERY(log, severity, (severity).sample)
+
+/**
+ * @brief Keeps each record from the call site with probability @p p.
+ */
+#define QLOG_SAMPLE_CHANCE(log, severity, p) \
+  QLOG_SAMPLE_IF(log, severity, qlog::sample_chance(p))
+
+/**
+ * @brief Keeps the records of one key in every @p n, so that all the records of a kept request
+ *        are kept together.
+ *
+ * For example:
+ *
+ *     QLOG_SAMPLE_KEY(log, qlog::debug, request.id, 100) << "parsed " << request.path;
+ */
+#define QLOG_SAMPLE_KEY(log, severity, key, n) \
+  QLOG_SAMPLE_IF(log, severity, qlog::sample_key((key), (n)))
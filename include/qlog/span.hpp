@@ -0,0 +1,237 @@
+/** @file qlog/span.hpp */
+
+#pragma once
+#include <qlog.hpp>
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Returns the number of spans open on the calling thread.
+     */
+    inline unsigned& span_depth() {
+      static thread_local unsigned depth = 0;
+      return depth;
+    }
+
+    /**
+     * @brief Returns a reading of the clock that spans of a log with clock @p c are timed by.
+     *
+     * The wall clock may step, so spans of a log that uses it are timed by @c CLOCK_MONOTONIC.
+     */
+    inline std::uint64_t span_ticks(clock_policy c) {
+      return c == clock_policy::wall ? clock_nanoseconds(CLOCK_MONOTONIC) : clock_ticks(c);
+    }
+
+    /**
+     * @brief Appends @p ns nanoseconds to @p out as microseconds with three decimals.
+     */
+    inline void append_microseconds(record_buffer& out, unsigned long long ns) {
+      char b[24];
+      std::size_t n = format_decimal(b, ns / 1000);
+      unsigned const f = static_cast<unsigned>(ns % 1000);
+      b[n++] = '.';
+      b[n++] = static_cast<char>('0' + f / 100);
+      b[n++] = static_cast<char>('0' + f / 10 % 10);
+      b[n++] = static_cast<char>('0' + f % 10);
+      out.append(b, n);
+    }
+  }
+
+  /**
+   * @brief Writes spans as Chrome trace events, which @c chrome://tracing and Perfetto load.
+   *
+   * Each span becomes one complete (@c "ph":"X") event of a JSON array. The array is closed when
+   * the trace is destroyed; a viewer also loads a trace whose process died before that. For
+   * example:
+   *
+   *     std::ofstream trace_file("trace.json");
+   *     qlog::chrome_trace trace(trace_file);
+   *     qlog::span s(log, qlog::debug, "parse", &trace);
+   */
+  class chrome_trace {
+    public:
+      /**
+       * @brief Initializes a new qlog::chrome_trace that writes to a stream.
+       * @param[in] o Stream that receives the events.
+       */
+      explicit chrome_trace(std::ostream& o)
+        : _stream(new ostream_sink(o)), _output(_stream.get()), _first(true) {
+      }
+
+      /**
+       * @brief Initializes a new qlog::chrome_trace that writes to a sink.
+       * @param[in] o Sink that receives the events. It must outlive the trace.
+       */
+      explicit chrome_trace(sink& o) : _output(&o), _first(true) { }
+
+      chrome_trace(chrome_trace const&) = delete;
+      chrome_trace& operator=(chrome_trace const&) = delete;
+
+      /**
+       * @brief Destructor. Closes the array of events.
+       */
+      ~chrome_trace() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_first) {
+          _output->write("[", 1);
+        }
+        _output->write("\n]\n", 3);
+        _output->flush();
+      }
+
+      /**
+       * @brief Writes the event of a span that has ended.
+       * @param[in] name Name of the span.
+       * @param[in] start Wall clock time at which the span started.
+       * @param[in] nanoseconds How long the span took.
+       * @param[in] depth Number of spans open on the thread when the span started, itself
+       *                  included.
+       */
+      void complete(char const* name, struct timespec const& start,
+                    unsigned long long nanoseconds, unsigned depth) {
+        record_buffer b;
+        b.append("{\"name\":", 8);
+        detail::append_quoted(b, name, std::strlen(name));
+        b.append(",\"cat\":\"qlog\",\"ph\":\"X\",\"ts\":", 28);
+        detail::append_microseconds(b, static_cast<unsigned long long>(start.tv_sec) *
+                                       1000000000ULL +
+                                       static_cast<unsigned long long>(start.tv_nsec));
+        b.append(",\"dur\":", 7);
+        detail::append_microseconds(b, nanoseconds);
+        char n[24];
+        b.append(",\"pid\":", 7);
+        b.append(n, detail::format_decimal(n, static_cast<long long>(::getpid())));
+        b.append(",\"tid\":", 7);
+        b.append(n, detail::format_decimal(n, static_cast<long long>(detail::thread_id())));
+        b.append(",\"args\":{\"depth\":", 17);
+        b.append(n, detail::format_decimal(n, static_cast<unsigned long long>(depth)));
+        b.append("}}", 2);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _output->write(_first ? "[\n" : ",\n", 2);
+        _first = false;
+        _output->write(b.data(), b.size());
+      }
+
+      /**
+       * @brief Flushes the events written so far to the stream or sink.
+       */
+      void flush() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _output->flush();
+      }
+
+    private:
+      /** @brief Sink that wraps the output stream when the trace was given a stream. */
+      std::unique_ptr<sink> _stream;
+
+      /** @brief Sink that receives the events. */
+      sink* _output;
+
+      /** @brief Serializes writes to the sink. */
+      std::mutex _mutex;
+
+      /** @brief @c true until the first event has been written. */
+      bool _first;
+  };
+
+  /**
+   * @brief Times a block and writes one record with its duration when it ends.
+   *
+   * The span reads its log's clock when it is created and again when it is destroyed, and then
+   * writes a record of its severity whose message is the span's name, with the fields
+   * @c duration_ns and @c depth, the number of spans open on the thread including itself. A span
+   * whose severity is filtered out only checks the log's verbosity. For example:
+   *
+   *     void parse() {
+   *       qlog::span s(log, qlog::debug, "parse");
+   *       ...
+   *     }
+   *     // ... [DEBUG] parse duration_ns=12345 depth=1
+   *
+   * Use qlog::logger::set_clock() to time spans with the time stamp counter. The spans of a log
+   * that reads the wall clock are timed by @c CLOCK_MONOTONIC.
+   */
+  class span {
+    public:
+      /**
+       * @brief Initializes a new qlog::span and starts timing it.
+       * @param[in] l Log that receives the span's record. It must outlive the span.
+       * @param[in] s Severity of the record.
+       * @param[in] name Name of the span, such as a string literal. It must outlive the span.
+       * @param[in] trace Trace that also receives the span as an event, or @c nullptr.
+       */
+      span(logger& l, severity_t const& s, char const* name, chrome_trace* trace = nullptr)
+        : _log(l.enabled(s) ? &l : nullptr), _severity(&s), _name(name), _trace(trace),
+          _clock(clock_policy::wall), _depth(0), _start(0) {
+        if(_log) {
+          _clock = l.clock();
+          _depth = ++detail::span_depth();
+          _start = detail::span_ticks(_clock);
+        }
+      }
+
+      span(span const&) = delete;
+      span& operator=(span const&) = delete;
+
+      /**
+       * @brief Destructor. Writes the span's record, and its event if it has a trace.
+       */
+      ~span() {
+        if(!_log) {
+          return;
+        }
+        unsigned long long const ns = elapsed();
+        --detail::span_depth();
+        {
+          record r = (*_log)(*_severity);
+          r.kv("duration_ns", ns).kv("depth", _depth) << _name;
+        }
+        if(_trace) {
+          struct timespec start = detail::clock_time(_clock);
+          long long const at = static_cast<long long>(start.tv_nsec) -
+                               static_cast<long long>(ns % 1000000000);
+          start.tv_sec -= static_cast<time_t>(ns / 1000000000 + (at < 0 ? 1 : 0));
+          start.tv_nsec = static_cast<long>(at < 0 ? at + 1000000000 : at);
+          _trace->complete(_name, start, ns, _depth);
+        }
+      }
+
+      /**
+       * @brief Returns the nanoseconds since the span started, or 0 if it is filtered out.
+       */
+      unsigned long long elapsed() const {
+        if(!_log) {
+          return 0;
+        }
+        std::uint64_t const ticks = detail::span_ticks(_clock) - _start;
+        double const scale = _clock == clock_policy::wall ? 1.0 : detail::anchor(_clock).scale;
+        return scale == 1.0 ? ticks
+                            : static_cast<unsigned long long>(static_cast<double>(ticks) * scale);
+      }
+
+    private:
+      /** @brief Log that receives the span's record, or @c nullptr if it is filtered out. */
+      logger* const _log;
+
+      /** @brief Severity of the span's record. */
+      severity_t const* const _severity;
+
+      /** @brief Name of the span. */
+      char const* const _name;
+
+      /** @brief Trace that receives the span's event, or @c nullptr. */
+      chrome_trace* const _trace;
+
+      /** @brief Clock that times the span. */
+      clock_policy _clock;
+
+      /** @brief Number of spans open on the thread when the span started, itself included. */
+      unsigned _depth;
+
+      /** @brief Reading of the clock when the span started. */
+      std::uint64_t _start;
+  };
+}
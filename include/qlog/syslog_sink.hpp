@@ -0,0 +1,582 @@
+/** @file qlog/syslog_sink.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief Largest number of datagrams a qlog::udp_sink, qlog::syslog_sink or qlog::journald_sink
+ *        hands to one @c sendmmsg call.
+ *
+ * Define it before including qlog/syslog_sink.hpp to change it.
+ */
+#ifndef QLOG_DATAGRAM_BATCH
+#define QLOG_DATAGRAM_BATCH 64
+#endif
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Connects a datagram socket to a host and port.
+     * @returns the socket, or -1 if none of the host's addresses could be used.
+     */
+    inline int connect_udp(std::string const& host, unsigned short port) {
+      struct addrinfo hints;
+      std::memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_DGRAM;
+      struct addrinfo* found = nullptr;
+      if(::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+        return -1;
+      }
+      int fd = -1;
+      for(struct addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if(fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+          ::close(fd);
+          fd = -1;
+        }
+      }
+      ::freeaddrinfo(found);
+      return fd;
+    }
+
+    /**
+     * @brief Connects a datagram socket to a Unix domain socket, such as @c /dev/log.
+     * @returns the socket, or -1 if it could not be connected.
+     */
+    inline int connect_unix(std::string const& path) {
+      struct sockaddr_un a;
+      std::memset(&a, 0, sizeof(a));
+      if(path.size() >= sizeof(a.sun_path)) {
+        return -1;
+      }
+      a.sun_family = AF_UNIX;
+      std::memcpy(a.sun_path, path.data(), path.size());
+      int const fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      if(fd >= 0 && ::connect(fd, reinterpret_cast<struct sockaddr*>(&a), sizeof(a)) != 0) {
+        ::close(fd);
+        return -1;
+      }
+      return fd;
+    }
+
+    /**
+     * @brief Returns @c true if the @p n bytes at @p d are a timestamp as the logger writes
+     *        them, @c YYYY-MM-DDThh:mm:ss, then a fraction of up to nine digits, then @c Z.
+     */
+    inline bool is_timestamp(char const* d, std::size_t n) {
+      static char const shape[] = "0000-00-00T00:00:00";
+      if(n < 20 || n > 30 || d[n - 1] != 'Z') {
+        return false;
+      }
+      for(std::size_t i = 0; i + 1 < sizeof(shape); ++i) {
+        bool const digit = d[i] >= '0' && d[i] <= '9';
+        if(shape[i] == '0' ? !digit : d[i] != shape[i]) {
+          return false;
+        }
+      }
+      if(n == 20) {
+        return true;
+      }
+      if(n == 21 || d[19] != '.') {
+        return false;
+      }
+      for(std::size_t i = 20; i + 1 < n; ++i) {
+        if(d[i] < '0' || d[i] > '9') {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /**
+     * @brief Parts of one record in the default text format,
+     *        @c "<timestamp> [<severity>] <message>".
+     *
+     * Only the timestamp and the message are used; the level comes with the record.
+     */
+    struct text_record {
+      /**
+       * @brief Splits the record of @p n bytes at @p d, without its newline. A record that does
+       *        not start with a timestamp the logger wrote, such as an encoded one, has no
+       *        timestamp, and all of it is the message.
+       */
+      text_record(char const* d, std::size_t n)
+        : timestamp(d), timestamp_size(0), message(d), message_size(n) {
+        char const* const space = static_cast<char const*>(std::memchr(d, ' ', n));
+        if(!space || n - (space - d) < 3 || space[1] != '[' ||
+           !is_timestamp(d, static_cast<std::size_t>(space - d))) {
+          return;
+        }
+        char const* const name = space + 2;
+        char const* const close =
+            static_cast<char const*>(std::memchr(name, ']', n - (name - d)));
+        if(!close) {
+          return;
+        }
+        timestamp_size = static_cast<std::size_t>(space - d);
+        message = close + 1 < d + n && close[1] == ' ' ? close + 2 : close + 1;
+        message_size = n - static_cast<std::size_t>(message - d);
+      }
+
+      /** @brief Timestamp of the record. */
+      char const* timestamp;
+
+      /** @brief Length of the timestamp, or 0 if the record has none. */
+      std::size_t timestamp_size;
+
+      /** @brief Text of the record after its severity. */
+      char const* message;
+
+      /** @brief Length of the message. */
+      std::size_t message_size;
+    };
+
+    /**
+     * @brief Returns the syslog severity, from 0 (emergency) to 7 (debug), of a record of level
+     *        @p level.
+     * @param[in] level Level of the severity of the record, or QLOG_LEVEL_INHERIT if it is not
+     *                  known.
+     * @param[in] fallback Severity of a record whose level is not known.
+     *
+     * Custom severities take the syslog severity of the next predefined one below them, except
+     * that those between qlog::warn and qlog::info are notices.
+     */
+    inline int syslog_severity(unsigned long level, int fallback) {
+      return level == QLOG_LEVEL_INHERIT ? fallback : level <= QLOG_LEVEL_FATAL ? 2
+           : level <= QLOG_LEVEL_ERROR ? 3 : level <= QLOG_LEVEL_WARN ? 4
+           : level < QLOG_LEVEL_INFO ? 5 : level == QLOG_LEVEL_INFO ? 6 : 7;
+    }
+
+    /**
+     * @brief Datagrams waiting to be sent on a connected socket with as few system calls as
+     *        possible.
+     *
+     * Datagrams are built one after another in a single buffer and then handed to @c sendmmsg
+     * in groups of QLOG_DATAGRAM_BATCH. The buffer and the message headers are kept from one batch
+     * to the next, so a steady stream of records does not allocate.
+     */
+    class datagram_batch {
+      public:
+        datagram_batch() : _start(0), _dropped(0) {
+          _ends.reserve(QLOG_DATAGRAM_BATCH);
+        }
+
+        /** @brief Returns the number of bytes in the datagram being built. */
+        std::size_t size() const {
+          return _data.size() - _start;
+        }
+
+        /** @brief Returns @c true if the datagram being built is empty. */
+        bool empty() const {
+          return _data.size() == _start;
+        }
+
+        /** @brief Appends @p n bytes at @p s to the datagram being built. */
+        void append(char const* s, std::size_t n) {
+          _data.append(s, n);
+        }
+
+        /** @brief Appends a string to the datagram being built. */
+        void append(std::string const& s) {
+          _data.append(s);
+        }
+
+        /** @brief Appends one character to the datagram being built. */
+        void push_back(char c) {
+          _data.push_back(c);
+        }
+
+        /**
+         * @brief Finishes the datagram being built, sending the batch on @p fd if it is full.
+         */
+        void end(int fd) {
+          if(empty()) {
+            return;
+          }
+          _ends.push_back(_data.size());
+          _start = _data.size();
+          if(_ends.size() == QLOG_DATAGRAM_BATCH) {
+            send(fd);
+          }
+        }
+
+        /**
+         * @brief Sends every finished datagram on @p fd, keeping the one being built.
+         *
+         * Datagrams the socket refuses, for example because nothing is listening on the other
+         * side, are counted and discarded.
+         */
+        void send(int fd) {
+          std::size_t const count = _ends.size();
+          struct iovec v[QLOG_DATAGRAM_BATCH];
+          struct mmsghdr m[QLOG_DATAGRAM_BATCH];
+          std::memset(m, 0, sizeof(struct mmsghdr) * count);
+          std::size_t begin = 0;
+          for(std::size_t i = 0; i < count; ++i) {
+            v[i].iov_base = &_data[begin];
+            v[i].iov_len = _ends[i] - begin;
+            m[i].msg_hdr.msg_iov = &v[i];
+            m[i].msg_hdr.msg_iovlen = 1;
+            begin = _ends[i];
+          }
+          for(std::size_t sent = 0; sent < count;) {
+            int const n = ::sendmmsg(fd, m + sent, static_cast<unsigned>(count - sent), 0);
+            if(n > 0) {
+              sent += static_cast<std::size_t>(n);
+            } else if(n < 0 && errno == EINTR) {
+              continue;
+            } else {
+              // The first datagram was refused; give up on it and try the rest.
+              ++_dropped;
+              ++sent;
+            }
+          }
+          _data.erase(0, begin);
+          _start -= begin;
+          _ends.clear();
+        }
+
+        /** @brief Returns the number of datagrams the socket refused. */
+        unsigned long long dropped() const {
+          return _dropped;
+        }
+
+      private:
+        /** @brief Text of the datagrams. */
+        std::string _data;
+
+        /** @brief Offset of the end of each finished datagram. */
+        std::vector<std::size_t> _ends;
+
+        /** @brief Offset of the datagram being built. */
+        std::size_t _start;
+
+        /** @brief Number of datagrams the socket refused. */
+        unsigned long long _dropped;
+    };
+
+    /**
+     * @brief Common part of the sinks that send records over a datagram socket.
+     *
+     * The sink takes records one at a time, with their levels, and a derived sink turns each
+     * whole record, newlines and all, into datagrams with qlog::detail::datagram_sink::record().
+     * Everything it has built is sent together when the sink is flushed, which a log does after
+     * each batch.
+     */
+    class datagram_sink : public sink {
+      public:
+        datagram_sink(datagram_sink const&) = delete;
+        datagram_sink& operator=(datagram_sink const&) = delete;
+
+        /**
+         * @brief Destructor. Closes the socket.
+         */
+        ~datagram_sink() {
+          if(_fd >= 0) {
+            ::close(_fd);
+          }
+        }
+
+        /**
+         * @brief Returns @c true if the socket could be connected.
+         */
+        bool is_open() const {
+          return _fd >= 0;
+        }
+
+        /**
+         * @brief Returns the number of datagrams the socket refused.
+         */
+        unsigned long long dropped() const {
+          return _batch.dropped();
+        }
+
+        /**
+         * @brief Sends records whose levels are not known, such as those of a sink that wraps
+         *        this one. Each line becomes a record, with the default severity.
+         */
+        void write(char const* d, std::size_t n) override {
+          if(_fd < 0) {
+            return;
+          }
+          while(n > 0) {
+            char const* const newline = static_cast<char const*>(std::memchr(d, '\n', n));
+            std::size_t const line = newline ? static_cast<std::size_t>(newline - d) : n;
+            if(line) {
+              record(d, line, QLOG_LEVEL_INHERIT);
+            }
+            std::size_t const used = newline ? line + 1 : line;
+            d += used;
+            n -= used;
+          }
+          flush();
+        }
+
+        bool per_record() const override {
+          return true;
+        }
+
+        void write_record(char const* d, std::size_t n, unsigned long level) override {
+          if(_fd < 0) {
+            return;
+          }
+          if(n && d[n - 1] == '\n') {
+            --n;
+          }
+          if(n) {
+            record(d, n, level);
+          }
+        }
+
+        /**
+         * @brief Sends every record written since the last flush.
+         */
+        void flush() override {
+          if(_fd < 0) {
+            return;
+          }
+          finish();
+          _batch.send(_fd);
+        }
+
+      protected:
+        /**
+         * @brief Initializes a new qlog::detail::datagram_sink that owns the socket @p fd.
+         */
+        explicit datagram_sink(int fd) : _fd(fd) { }
+
+        /**
+         * @brief Adds one record of @p n bytes at @p d, without its final newline, to the batch.
+         * @param[in] level Level of the severity of the record, or QLOG_LEVEL_INHERIT if it is
+         *                  not known.
+         */
+        virtual void record(char const* d, std::size_t n, unsigned long level) = 0;
+
+        /**
+         * @brief Finishes a datagram the sink has left open once the last record before a flush
+         *        has been seen.
+         */
+        virtual void finish() { }
+
+        /** @brief The connected socket, or -1. */
+        int const _fd;
+
+        /** @brief Datagrams waiting to be sent. */
+        datagram_batch _batch;
+    };
+  }
+
+  /**
+   * @brief Sink that sends records over UDP as they are, packing as many whole records into each
+   *        datagram as fit.
+   *
+   * Each datagram holds one or more newline terminated records and is at most as large as the
+   * limit, except that a record that is larger than the limit is sent alone. For example:
+   *
+   *     qlog::udp_sink collector("collector.example.com", 5140);
+   *     qlog::logger log(collector, qlog::info, 4096);
+   */
+  class udp_sink : public detail::datagram_sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::udp_sink and connects its socket.
+       * @param[in] host Name or address of the receiver.
+       * @param[in] port UDP port of the receiver.
+       * @param[in] max_size Largest number of bytes in a datagram that holds more than one record.
+       *                     The default fits an Ethernet frame without fragments.
+       */
+      udp_sink(std::string const& host, unsigned short port, std::size_t max_size = 1472)
+        : datagram_sink(detail::connect_udp(host, port)), _max_size(max_size) {
+      }
+
+    protected:
+      void record(char const* d, std::size_t n, unsigned long) override {
+        if(!_batch.empty() && _batch.size() + n + 1 > _max_size) {
+          _batch.end(_fd);
+        }
+        _batch.append(d, n);
+        _batch.push_back('\n');
+      }
+
+      void finish() override {
+        _batch.end(_fd);
+      }
+
+    private:
+      /** @brief Largest number of bytes in a datagram that holds more than one record. */
+      std::size_t const _max_size;
+  };
+
+  /**
+   * @brief Sink that sends each record as an RFC 5424 syslog message, over UDP or to a local
+   *        Unix domain socket.
+   *
+   * The priority of each message comes from the level of its record, whatever its format:
+   * qlog::fatal becomes critical, qlog::error error, qlog::warn warning, qlog::info
+   * informational and qlog::debug debug; see qlog::detail::syslog_severity() for the custom
+   * severities. A record of several lines is one message. The record's own timestamp, in the
+   * default text format, becomes the message's timestamp; a record in any other format, such as
+   * an encoded one, is sent whole as the message, with no timestamp. RFC 5426 allows a single
+   * message per datagram, so the datagrams of a batch are sent together with @c sendmmsg
+   * instead. For example:
+   *
+   *     qlog::syslog_sink local("myapp");                             // /dev/log
+   *     qlog::syslog_sink remote("myapp", "syslog.example.com", 514); // UDP
+   *     qlog::logger log(remote, qlog::info, 4096);
+   */
+  class syslog_sink : public detail::datagram_sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::syslog_sink that sends to a local Unix domain socket.
+       * @param[in] app Name of the program in each message.
+       * @param[in] path Socket of the local syslog daemon.
+       * @param[in] facility Facility number, from 0 to 23; 1 is user-level messages.
+       * @param[in] fallback Syslog severity of records written without their level; 5 is
+       *                     notice.
+       */
+      explicit syslog_sink(std::string const& app, std::string const& path = "/dev/log",
+                           int facility = 1, int fallback = 5)
+        : datagram_sink(detail::connect_unix(path)), _facility(facility), _fallback(fallback) {
+        header(app);
+      }
+
+      /**
+       * @brief Initializes a new qlog::syslog_sink that sends over UDP.
+       * @param[in] app Name of the program in each message.
+       * @param[in] host Name or address of the syslog server.
+       * @param[in] port UDP port of the syslog server, normally 514.
+       * @param[in] facility Facility number, from 0 to 23; 1 is user-level messages.
+       * @param[in] fallback Syslog severity of records written without their level; 5 is
+       *                     notice.
+       */
+      syslog_sink(std::string const& app, std::string const& host, unsigned short port,
+                  int facility = 1, int fallback = 5)
+        : datagram_sink(detail::connect_udp(host, port)), _facility(facility),
+          _fallback(fallback) {
+        header(app);
+      }
+
+    protected:
+      void record(char const* d, std::size_t n, unsigned long level) override {
+        detail::text_record const r(d, n);
+        char b[24];
+        int const pri = _facility * 8 + detail::syslog_severity(level, _fallback);
+        _batch.append(b, static_cast<std::size_t>(std::snprintf(b, sizeof(b), "<%d>1 ", pri)));
+        if(r.timestamp_size) {
+          // RFC 5424 allows at most six fractional digits.
+          std::size_t const dot = 19;
+          if(r.timestamp_size > dot + 8 && r.timestamp[dot] == '.') {
+            _batch.append(r.timestamp, dot + 7);
+            _batch.append(r.timestamp + r.timestamp_size - 1, 1);
+          } else {
+            _batch.append(r.timestamp, r.timestamp_size);
+          }
+        } else {
+          _batch.push_back('-');
+        }
+        _batch.append(_header);
+        _batch.append(r.message, r.message_size);
+        _batch.end(_fd);
+      }
+
+    private:
+      /**
+       * @brief Builds the part of each message between its timestamp and its text.
+       */
+      void header(std::string const& app) {
+        char host[256];
+        if(::gethostname(host, sizeof(host)) != 0) {
+          host[0] = '\0';
+        }
+        host[sizeof(host) - 1] = '\0';
+        _header = " ";
+        _header += host[0] ? host : "-";
+        _header += " ";
+        _header += app.empty() ? "-" : app;
+        _header += " " + std::to_string(::getpid()) + " - - ";
+      }
+
+      /** @brief Facility number of each message. */
+      int const _facility;
+
+      /** @brief Syslog severity of records written without their level. */
+      int const _fallback;
+
+      /** @brief Host name, program name, process, message ID and structured data. */
+      std::string _header;
+  };
+
+  /**
+   * @brief Sink that sends each record to systemd-journald with its native protocol.
+   *
+   * Each record becomes one journal entry with the fields @c MESSAGE, @c PRIORITY,
+   * @c SYSLOG_IDENTIFIER and @c SYSLOG_PID, where the priority is worked out as for a
+   * qlog::syslog_sink. A message of several lines is sent in the protocol's binary form, so it
+   * stays one entry. The journal takes one entry per datagram, so the datagrams of a batch are
+   * sent together with @c sendmmsg. For example:
+   *
+   *     qlog::journald_sink journal("myapp");
+   *     qlog::logger log(journal, qlog::info, 4096);
+   */
+  class journald_sink : public detail::datagram_sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::journald_sink and connects to the journal.
+       * @param[in] app Value of the @c SYSLOG_IDENTIFIER field of each entry.
+       * @param[in] path Native socket of the journal.
+       * @param[in] fallback Priority of records written without their level; 5 is notice.
+       */
+      explicit journald_sink(std::string const& app,
+                             std::string const& path = "/run/systemd/journal/socket",
+                             int fallback = 5)
+        : datagram_sink(detail::connect_unix(path)), _fallback(fallback),
+          _fields("SYSLOG_IDENTIFIER=" + app + "\nSYSLOG_PID=" + std::to_string(::getpid()) +
+                  "\n") {
+      }
+
+    protected:
+      void record(char const* d, std::size_t n, unsigned long level) override {
+        detail::text_record const r(d, n);
+        char const priority[] = { 'P', 'R', 'I', 'O', 'R', 'I', 'T', 'Y', '=',
+                                  static_cast<char>('0' + detail::syslog_severity(level,
+                                                                                  _fallback)),
+                                  '\n' };
+        _batch.append(priority, sizeof(priority));
+        _batch.append(_fields);
+        if(std::memchr(r.message, '\n', r.message_size)) {
+          // The name, a newline, the length as 64 little endian bits, and the value.
+          _batch.append("MESSAGE\n", 8);
+          std::uint64_t length = r.message_size;
+          for(int i = 0; i < 8; ++i) {
+            _batch.push_back(static_cast<char>(length & 0xff));
+            length >>= 8;
+          }
+        } else {
+          _batch.append("MESSAGE=", 8);
+        }
+        _batch.append(r.message, r.message_size);
+        _batch.push_back('\n');
+        _batch.end(_fd);
+      }
+
+    private:
+      /** @brief Priority of records written without their level. */
+      int const _fallback;
+
+      /** @brief Fields that are the same in every entry. */
+      std::string const _fields;
+  };
+}
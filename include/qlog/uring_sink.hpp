@@ -0,0 +1,517 @@
+/** @file qlog/uring_sink.hpp */
+
+#pragma once
+#include <qlog.hpp>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace qlog {
+
+  /** @namespace qlog::detail */
+  namespace detail {
+    /**
+     * @brief Submission and completion rings of an io_uring instance, used through the raw
+     *        system calls.
+     *
+     * Only one thread may use a ring at a time.
+     */
+    class uring {
+      public:
+        /**
+         * @brief Sets up a ring with room for @p entries submissions.
+         */
+        explicit uring(unsigned entries)
+          : _fd(-1), _sq(MAP_FAILED), _cq(MAP_FAILED), _sqes(MAP_FAILED), _sq_size(0),
+            _cq_size(0), _sqes_size(0) {
+          struct io_uring_params p;
+          std::memset(&p, 0, sizeof(p));
+          _fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+          if(_fd < 0) {
+            return;
+          }
+          _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+          _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+          bool const single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+          if(single) {
+            _sq_size = _cq_size = _sq_size > _cq_size ? _sq_size : _cq_size;
+          }
+          _sq = ::mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                       IORING_OFF_SQ_RING);
+          _cq = single ? _sq
+                       : ::mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+          _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+          _sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         _fd, IORING_OFF_SQES);
+          if(_sq == MAP_FAILED || _cq == MAP_FAILED || _sqes == MAP_FAILED) {
+            close();
+            return;
+          }
+          char* const sq = static_cast<char*>(_sq);
+          char* const cq = static_cast<char*>(_cq);
+          _sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+          _sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+          _sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+          _cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+          _cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+          _cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+          _cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+        }
+
+        uring(uring const&) = delete;
+        uring& operator=(uring const&) = delete;
+
+        /**
+         * @brief Destructor. Tears the ring down.
+         */
+        ~uring() {
+          close();
+        }
+
+        /**
+         * @brief Returns @c true if the ring could be set up.
+         */
+        bool is_open() const {
+          return _fd >= 0;
+        }
+
+        /**
+         * @brief Registers buffers that fixed writes may refer to by index.
+         * @returns @c false if the kernel refused, for example because of @c RLIMIT_MEMLOCK.
+         */
+        bool register_buffers(struct iovec const* v, unsigned n) {
+          return ::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, v, n) == 0;
+        }
+
+        /**
+         * @brief Returns the next free submission entry, cleared. Call submit() once it is filled.
+         */
+        struct io_uring_sqe& next() {
+          unsigned const tail = *_sq_tail;
+          struct io_uring_sqe& e = static_cast<struct io_uring_sqe*>(_sqes)[tail & _sq_mask];
+          std::memset(&e, 0, sizeof(e));
+          return e;
+        }
+
+        /**
+         * @brief Hands the entry returned by next() to the kernel.
+         * @returns @c false if the kernel did not take it.
+         */
+        bool submit() {
+          unsigned const tail = *_sq_tail;
+          _sq_array[tail & _sq_mask] = tail & _sq_mask;
+          __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+          for(;;) {
+            long const r = ::syscall(__NR_io_uring_enter, _fd, 1, 0, 0, nullptr, 0);
+            if(r >= 0 || errno != EINTR) {
+              return r == 1;
+            }
+          }
+        }
+
+        /**
+         * @brief Hands every completion that has arrived to @p f.
+         * @param[in] wait @c true to wait for at least one completion first.
+         * @param[in] f Called with the @c user_data and @c res of each completion.
+         */
+        template<typename F>
+        void reap(bool wait, F f) {
+          unsigned head = *_cq_head;
+          if(wait && head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+            while(::syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr,
+                            0) < 0 && errno == EINTR) {
+            }
+          }
+          while(head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe const& c = _cqes[head & _cq_mask];
+            f(c.user_data, c.res);
+            ++head;
+          }
+          __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        }
+
+      private:
+        /**
+         * @brief Unmaps the rings and closes the instance.
+         */
+        void close() {
+          if(_sqes != MAP_FAILED) {
+            ::munmap(_sqes, _sqes_size);
+          }
+          if(_cq != MAP_FAILED && _cq != _sq) {
+            ::munmap(_cq, _cq_size);
+          }
+          if(_sq != MAP_FAILED) {
+            ::munmap(_sq, _sq_size);
+          }
+          _sq = _cq = _sqes = MAP_FAILED;
+          if(_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+          }
+        }
+
+        /** @brief Descriptor of the instance, or -1. */
+        int _fd;
+
+        /** @brief Mapping of the submission ring. */
+        void* _sq;
+
+        /** @brief Mapping of the completion ring, which may be the submission ring's. */
+        void* _cq;
+
+        /** @brief Mapping of the submission entries. */
+        void* _sqes;
+
+        /** @brief Size of qlog::detail::uring::_sq. */
+        std::size_t _sq_size;
+
+        /** @brief Size of qlog::detail::uring::_cq. */
+        std::size_t _cq_size;
+
+        /** @brief Size of qlog::detail::uring::_sqes. */
+        std::size_t _sqes_size;
+
+        /** @brief Tail of the submission ring, which this side advances. */
+        unsigned* _sq_tail;
+
+        /** @brief Mask that maps a submission position to an index. */
+        unsigned _sq_mask;
+
+        /** @brief Indices of the submission entries, in order. */
+        unsigned* _sq_array;
+
+        /** @brief Head of the completion ring, which this side advances. */
+        unsigned* _cq_head;
+
+        /** @brief Tail of the completion ring, which the kernel advances. */
+        unsigned* _cq_tail;
+
+        /** @brief Mask that maps a completion position to an index. */
+        unsigned _cq_mask;
+
+        /** @brief Completion entries. */
+        struct io_uring_cqe* _cqes;
+    };
+  }
+
+  /**
+   * @brief Sink that writes to a file through io_uring, so the writing thread rarely blocks in
+   *        the kernel.
+   *
+   * Records are copied into one of a few buffers, which are registered with the kernel once and
+   * submitted as fixed writes at explicit offsets when they fill up or the sink is flushed. The
+   * writing thread only waits when every buffer is still being written, which slows it, and the
+   * log's queue and its qlog::overflow_policy, down to the pace of the disk. A buffer is reused
+   * as soon as its write completes. With a sync interval a flush also submits an @c fdatasync
+   * that runs after the writes before it, at most once per interval. Give the sink to an
+   * asynchronous qlog::logger, whose background thread then does the submitting:
+   *
+   *     qlog::uring_sink file("app.log");
+   *     qlog::logger log(file, qlog::info, 4096);
+   *
+   * Where io_uring is not available, or is turned off, the sink writes with @c pwrite instead.
+   * A flush submits the writes without waiting for them; wait() waits.
+   */
+  class uring_sink : public sink {
+    public:
+      /**
+       * @brief Initializes a new qlog::uring_sink and opens, or appends to, its file.
+       * @param[in] path Name of the file.
+       * @param[in] buffers Number of buffers that may be written at once; at least 1.
+       * @param[in] buffer_size Size of each buffer.
+       * @param[in] sync_interval Least time between two @c fdatasync calls, or 0 for none.
+       */
+      explicit uring_sink(std::string const& path, unsigned buffers = 8,
+                          std::size_t buffer_size = 256 * 1024,
+                          std::chrono::milliseconds sync_interval = std::chrono::milliseconds(0))
+        : _ring(buffers ? buffers + 1 : 2), _buffer_size(buffer_size ? buffer_size : 1),
+          _slots(buffers ? buffers : 1), _arena(_slots.size() * _buffer_size),
+          _sync_interval(sync_interval), _fd(-1), _offset(0), _current(0), _in_flight(0),
+          _fixed(false), _syncing(false), _errors(0) {
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        struct stat st;
+        if(_fd >= 0 && ::fstat(_fd, &st) == 0) {
+          _offset = static_cast<std::uint64_t>(st.st_size);
+        }
+        if(_ring.is_open()) {
+          std::vector<struct iovec> v(_slots.size());
+          for(std::size_t i = 0; i < v.size(); ++i) {
+            v[i].iov_base = buffer(i);
+            v[i].iov_len = _buffer_size;
+          }
+          _fixed = _ring.register_buffers(v.data(), static_cast<unsigned>(v.size()));
+        }
+        _synced = std::chrono::steady_clock::now();
+      }
+
+      uring_sink(uring_sink const&) = delete;
+      uring_sink& operator=(uring_sink const&) = delete;
+
+      /**
+       * @brief Destructor. Writes the last buffer, waits for every write, and closes the file.
+       */
+      ~uring_sink() {
+        wait();
+        if(_fd >= 0) {
+          ::close(_fd);
+        }
+      }
+
+      /**
+       * @brief Returns @c true if the file could be opened.
+       */
+      bool is_open() const {
+        return _fd >= 0;
+      }
+
+      /**
+       * @brief Returns @c true if writes go through io_uring rather than @c pwrite.
+       */
+      bool uses_uring() const {
+        return _ring.is_open();
+      }
+
+      /**
+       * @brief Returns the number of writes and syncs that failed.
+       */
+      unsigned long long errors() const {
+        return _errors;
+      }
+
+      void write(char const* d, std::size_t n) override {
+        if(_fd < 0) {
+          return;
+        }
+        if(!_ring.is_open()) {
+          put(d, n, _offset);
+          _offset += n;
+          return;
+        }
+        while(n > 0) {
+          slot& s = _slots[_current];
+          std::size_t const c = _buffer_size - s.size < n ? _buffer_size - s.size : n;
+          std::memcpy(buffer(_current) + s.size, d, c);
+          s.size += c;
+          d += c;
+          n -= c;
+          if(s.size == _buffer_size) {
+            submit_current();
+          }
+        }
+      }
+
+      /**
+       * @brief Submits the records written so far, and an @c fdatasync if one is due, without
+       *        waiting for them.
+       */
+      void flush() override {
+        if(!_ring.is_open()) {
+          if(due()) {
+            if(::fdatasync(_fd) != 0) {
+              ++_errors;
+            }
+            _synced = std::chrono::steady_clock::now();
+          }
+          return;
+        }
+        if(_slots[_current].size) {
+          submit_current();
+        }
+        reap(false);
+        if(due() && !_syncing) {
+          struct io_uring_sqe& e = _ring.next();
+          e.opcode = IORING_OP_FSYNC;
+          e.fd = _fd;
+          e.fsync_flags = IORING_FSYNC_DATASYNC;
+          e.flags = IOSQE_IO_DRAIN;
+          e.user_data = sync_tag;
+          if(_ring.submit()) {
+            _syncing = true;
+            ++_in_flight;
+          } else {
+            ++_errors;
+          }
+          _synced = std::chrono::steady_clock::now();
+        }
+      }
+
+      /**
+       * @brief Submits the records written so far and waits until every write has completed.
+       */
+      void wait() {
+        if(!_ring.is_open()) {
+          return;
+        }
+        if(_slots[_current].size) {
+          submit_current();
+        }
+        while(_in_flight) {
+          reap(true);
+        }
+      }
+
+    private:
+      /** @brief The @c user_data of an @c fdatasync submission. */
+      static const std::uint64_t sync_tag = ~0ULL;
+
+      /**
+       * @brief State of one buffer.
+       */
+      struct slot {
+        slot() : size(0), offset(0), busy(false) { }
+
+        /** @brief Number of bytes in the buffer. */
+        std::size_t size;
+
+        /** @brief Offset in the file at which the buffer is being written. */
+        std::uint64_t offset;
+
+        /** @brief @c true while the buffer is being written. */
+        bool busy;
+      };
+
+      /**
+       * @brief Returns the first byte of buffer @p i.
+       */
+      char* buffer(std::size_t i) {
+        return &_arena[i * _buffer_size];
+      }
+
+      /**
+       * @brief Returns @c true if an @c fdatasync is due.
+       */
+      bool due() const {
+        return _sync_interval.count() > 0 &&
+               std::chrono::steady_clock::now() - _synced >= _sync_interval;
+      }
+
+      /**
+       * @brief Submits the current buffer and moves on to a free one, waiting for one to complete
+       *        if every buffer is busy.
+       */
+      void submit_current() {
+        std::size_t const i = _current;
+        slot& s = _slots[i];
+        struct io_uring_sqe& e = _ring.next();
+        e.opcode = _fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        e.fd = _fd;
+        e.addr = reinterpret_cast<std::uint64_t>(buffer(i));
+        e.len = static_cast<std::uint32_t>(s.size);
+        e.off = _offset;
+        e.buf_index = static_cast<std::uint16_t>(i);
+        e.user_data = i;
+        s.offset = _offset;
+        _offset += s.size;
+        if(_ring.submit()) {
+          s.busy = true;
+          ++_in_flight;
+        } else {
+          put(buffer(i), s.size, s.offset);
+          s.size = 0;
+        }
+        for(;;) {
+          for(std::size_t j = 1; j <= _slots.size(); ++j) {
+            std::size_t const k = (i + j) % _slots.size();
+            if(!_slots[k].busy) {
+              _current = k;
+              return;
+            }
+          }
+          reap(true);
+        }
+      }
+
+      /**
+       * @brief Frees the buffers whose writes have completed.
+       * @param[in] wait @c true to wait for at least one completion first.
+       */
+      void reap(bool wait) {
+        _ring.reap(wait, [this](std::uint64_t tag, int res) {
+          --_in_flight;
+          if(tag == sync_tag) {
+            _syncing = false;
+            if(res < 0) {
+              ++_errors;
+            }
+            return;
+          }
+          slot& s = _slots[static_cast<std::size_t>(tag)];
+          if(res < 0) {
+            ++_errors;
+          } else if(static_cast<std::size_t>(res) < s.size) {
+            // A short write is finished on this thread.
+            put(buffer(static_cast<std::size_t>(tag)) + res, s.size - static_cast<std::size_t>(res),
+                s.offset + static_cast<std::uint64_t>(res));
+          }
+          s.size = 0;
+          s.busy = false;
+        });
+      }
+
+      /**
+       * @brief Writes @p n bytes at @p offset with @c pwrite.
+       */
+      void put(char const* d, std::size_t n, std::uint64_t offset) {
+        while(n > 0) {
+          ssize_t const w = ::pwrite(_fd, d, n, static_cast<off_t>(offset));
+          if(w < 0) {
+            if(errno == EINTR) {
+              continue;
+            }
+            ++_errors;
+            return;
+          }
+          d += w;
+          n -= static_cast<std::size_t>(w);
+          offset += static_cast<std::uint64_t>(w);
+        }
+      }
+
+      /** @brief The ring, which may have failed to set up. */
+      detail::uring _ring;
+
+      /** @brief Size of each buffer. */
+      std::size_t const _buffer_size;
+
+      /** @brief State of each buffer. */
+      std::vector<slot> _slots;
+
+      /** @brief Memory of every buffer, one after another. */
+      std::vector<char> _arena;
+
+      /** @brief Least time between two @c fdatasync calls, or 0. */
+      std::chrono::milliseconds const _sync_interval;
+
+      /** @brief Descriptor of the file, or -1 if it could not be opened. */
+      int _fd;
+
+      /** @brief Offset in the file of the next byte to write. */
+      std::uint64_t _offset;
+
+      /** @brief Index of the buffer that records are copied into. */
+      std::size_t _current;
+
+      /** @brief Number of submissions that have not completed. */
+      unsigned _in_flight;
+
+      /** @brief @c true if the buffers are registered, so writes may be fixed writes. */
+      bool _fixed;
+
+      /** @brief @c true while an @c fdatasync is in flight. */
+      bool _syncing;
+
+      /** @brief Number of writes and syncs that failed. */
+      unsigned long long _errors;
+
+      /** @brief When the last @c fdatasync was submitted. */
+      std::chrono::steady_clock::time_point _synced;
+  };
+}
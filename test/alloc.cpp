@@ -0,0 +1,105 @@
+#include <qlog.hpp>
+#include <qlog/binary.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t n) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* const p = std::malloc(n ? n : 1);
+  if(!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+/**
+ * @brief Sink that throws everything away.
+ */
+class null_sink : public qlog::sink {
+  public:
+    void write(char const*, std::size_t) override { }
+};
+
+/**
+ * @brief Logs @p n records of each shape the hot path must handle without allocating.
+ */
+template<typename Log>
+static void emit(Log& log, int n) {
+  std::string const name("steady");
+  for(int i = 0; i < n; ++i) {
+    int const value = i;
+    log(qlog::info) << value << " requests";
+    log(qlog::info) << "state " << name << ' ' << 2.5 << ' ' << static_cast<void*>(&log);
+    log(qlog::info).kv("requests", value).kv("name", name) << "fields";
+    log(qlog::debug) << "filtered " << value;
+  }
+  log.flush();
+}
+
+/**
+ * @brief Fails if logging allocates once the log has warmed up.
+ */
+template<typename Log>
+static int expect_none(char const* what, Log& log) {
+  emit(log, 1000);
+  unsigned long const before = allocations.load();
+  emit(log, 10000);
+  unsigned long const n = allocations.load() - before;
+  if(n != 0) {
+    std::cerr << what << ": " << n << " allocations in the steady state" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_sync() {
+  null_sink out;
+  qlog::logger log(out, qlog::info);
+  return expect_none("sync", log);
+}
+
+static int test_batched() {
+  null_sink out;
+  qlog::logger log(out, qlog::info);
+  log.set_flush_policy(qlog::flush_policy(100));
+  return expect_none("batched", log);
+}
+
+static int test_async(char const* what, qlog::overflow_policy p) {
+  null_sink out;
+  qlog::logger log(out, qlog::info, 64, p);
+  return expect_none(what, log);
+}
+
+static int test_binary() {
+  null_sink out;
+  qlog::binary_logger log(out, qlog::info);
+  unsigned long before = 0;
+  for(int i = 0; i < 2000; ++i) {
+    if(i == 1000) {
+      before = allocations.load();
+    }
+    QLOG_BINARY(log, qlog::info) << i << " requests " << 2.5;
+  }
+  log.flush();
+  unsigned long const n = allocations.load() - before;
+  if(n != 0) {
+    std::cerr << "binary: " << n << " allocations in the steady state" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_sync() || test_batched() || test_async("block", qlog::overflow_policy::block) ||
+         test_async("drop oldest", qlog::overflow_policy::drop_oldest) ||
+         test_async("drop newest", qlog::overflow_policy::drop_newest) || test_binary();
+}
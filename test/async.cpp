@@ -0,0 +1,134 @@
+#include <qlog.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Stream buffer that holds back every write until it is opened, simulating a slow sink.
+ */
+class gate_buf : public std::stringbuf {
+  public:
+    gate_buf() : _open(false) { }
+
+    void open() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _open = true;
+      _ready.notify_all();
+    }
+
+  protected:
+    std::streamsize xsputn(char const* s, std::streamsize n) override {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _ready.wait(lock, [this] { return _open; });
+      return std::stringbuf::xsputn(s, n);
+    }
+
+  private:
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    bool _open;
+};
+
+static std::size_t count_lines(std::string const& s) {
+  std::size_t n = 0;
+  for(auto c : s) {
+    if(c == '\n') {
+      ++n;
+    }
+  }
+  return n;
+}
+
+static int test_block() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info, 4, qlog::overflow_policy::block);
+    for(int i = 0; i < 1000; ++i) {
+      log(qlog::info) << "record " << std::to_string(i);
+      log(qlog::debug) << "filtered " << std::to_string(i);
+    }
+    log.flush();
+    if(count_lines(out.str()) != 1000 || log.dropped() != 0) {
+      std::cerr << "block: expected 1000 records and no drops after flush" << std::endl;
+      return 1;
+    }
+    log(qlog::info) << "last";
+  }
+  std::string const s = out.str();
+  if(count_lines(s) != 1001 || s.find("[INFO] record 0\n") == std::string::npos ||
+     s.find("[INFO] record 999\n") == std::string::npos ||
+     s.find("[INFO] last\n") == std::string::npos ||
+     s.find("filtered") != std::string::npos) {
+    std::cerr << "block: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Blocks several producers behind a full queue until the sink opens, and checks that every
+ *        record arrives once they are let through.
+ */
+static int test_block_threads() {
+  gate_buf buf;
+  std::ostream out(&buf);
+  {
+    qlog::logger log(out, qlog::info, 4, qlog::overflow_policy::block);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+      threads.emplace_back([&log, t] {
+        for(int i = 0; i < 200; ++i) {
+          log(qlog::info) << "thread " << t << " record " << i;
+        }
+      });
+    }
+    // By now the producers are asleep waiting for room.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    buf.open();
+    for(auto& t : threads) {
+      t.join();
+    }
+    if(log.dropped() != 0) {
+      std::cerr << "block threads: records were dropped" << std::endl;
+      return 1;
+    }
+  }
+  std::string const s = buf.str();
+  if(count_lines(s) != 800 || s.find("thread 3 record 199\n") == std::string::npos) {
+    std::cerr << "block threads: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_drop(qlog::overflow_policy p, char const* kept) {
+  gate_buf buf;
+  std::ostream out(&buf);
+  unsigned long long dropped = 0;
+  {
+    qlog::logger log(out, qlog::info, 4, p);
+    for(int i = 0; i < 100; ++i) {
+      log(qlog::info) << "record " << std::to_string(i);
+    }
+    log(qlog::info) << "end";
+    // Starting a filtered record queues "end" without queueing anything else.
+    log(qlog::debug) << "filtered";
+    dropped = log.dropped();
+    buf.open();
+  }
+  std::string const s = buf.str();
+  if(dropped == 0 || count_lines(s) + dropped != 101 || s.find(kept) == std::string::npos) {
+    std::cerr << "drop: expected " << kept << " to survive" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_block() || test_block_threads() ||
+         test_drop(qlog::overflow_policy::drop_newest, "[INFO] record 0\n") ||
+         test_drop(qlog::overflow_policy::drop_oldest, "[INFO] end\n");
+}
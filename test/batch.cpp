@@ -0,0 +1,154 @@
+#include <qlog.hpp>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Sink that keeps everything written to it and counts the calls to write().
+ */
+class counting_sink : public qlog::sink {
+  public:
+    counting_sink() : _writes(0), _largest(0) { }
+
+    void write(char const* d, std::size_t n) override {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _text.append(d, n);
+      ++_writes;
+      _largest = n > _largest ? n : _largest;
+    }
+
+    std::string text() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _text;
+    }
+
+    std::size_t writes() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _writes;
+    }
+
+    std::size_t largest() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _largest;
+    }
+
+  private:
+    std::mutex _mutex;
+    std::string _text;
+    std::size_t _writes;
+    std::size_t _largest;
+};
+
+static std::size_t count_lines(std::string const& s) {
+  std::size_t n = 0;
+  for(auto c : s) {
+    if(c == '\n') {
+      ++n;
+    }
+  }
+  return n;
+}
+
+static int test_every_record() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+  for(int i = 0; i < 5; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  log.flush();
+  if(out.writes() != 5 || count_lines(out.text()) != 5) {
+    std::cerr << "every record: expected 5 writes but got " << out.writes() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_records() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+  log.set_flush_policy(qlog::flush_policy(10));
+  for(int i = 0; i < 25; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  // Two batches of 10 have been written, and the last 5 records are still gathered.
+  if(out.writes() != 2 || count_lines(out.text()) != 20) {
+    std::cerr << "records: expected 2 writes of 10 records" << std::endl << out.text();
+    return 1;
+  }
+  log.flush();
+  if(out.writes() != 3 || count_lines(out.text()) != 25 ||
+     out.text().find("[INFO] record 24\n") == std::string::npos) {
+    std::cerr << "records: flush did not write the rest" << std::endl << out.text();
+    return 1;
+  }
+  return 0;
+}
+
+static int test_bytes() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+  log.set_flush_policy(qlog::flush_policy(0, 256));
+  for(int i = 0; i < 100; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  log.flush();
+  if(count_lines(out.text()) != 100 || out.writes() < 2 || out.writes() > 50 ||
+     out.largest() > 256) {
+    std::cerr << "bytes: " << out.writes() << " writes, the largest of " << out.largest()
+              << " bytes" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_severe() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+  log.set_flush_policy(qlog::flush_policy(0));
+  log(qlog::info) << "first";
+  log(qlog::warn) << "second";
+  if(out.writes() != 0) {
+    std::cerr << "severe: records were written before the error" << std::endl;
+    return 1;
+  }
+  log(qlog::error) << "failed";
+  std::string const s = out.text();
+  if(out.writes() != 1 || count_lines(s) != 3 ||
+     s.find("[ERROR] failed\n") == std::string::npos) {
+    std::cerr << "severe: error did not write the batch" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_interval() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info, 1024);
+  log.set_flush_policy(qlog::flush_policy(0, 1 << 20, std::chrono::milliseconds(50)));
+  log.flush();
+  for(int i = 0; i < 100; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  log(qlog::debug) << "filtered";
+  for(int i = 0; i < 100 && count_lines(out.text()) < 100; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if(count_lines(out.text()) != 100 || out.writes() > 10) {
+    std::cerr << "interval: " << out.writes() << " writes of " << count_lines(out.text())
+              << " records" << std::endl;
+    return 1;
+  }
+  log(qlog::info) << "last";
+  log.flush();
+  if(count_lines(out.text()) != 101) {
+    std::cerr << "interval: flush did not write the batch" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_every_record() || test_records() || test_bytes() || test_severe() ||
+         test_interval();
+}
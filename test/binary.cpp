@@ -0,0 +1,112 @@
+#include <qlog/binary.hpp>
+#include <sstream>
+#include <string>
+
+struct point {
+  int x;
+  int y;
+};
+
+static std::ostream& operator<<(std::ostream& o, point const& p) {
+  return o << '(' << p.x << ", " << p.y << ')';
+}
+
+static int evaluated = 0;
+
+static int expensive() {
+  return ++evaluated;
+}
+
+/**
+ * @brief Returns the text of every decoded line with the timestamp removed.
+ */
+static std::string messages(std::string const& s) {
+  std::istringstream in(s);
+  std::ostringstream out;
+  if(!qlog::decode(in, out)) {
+    return "decode failed";
+  }
+  std::istringstream lines(out.str());
+  std::string m;
+  std::string line;
+  while(std::getline(lines, line)) {
+    m += line.substr(line.find(' ') + 1) + "\n";
+  }
+  return m;
+}
+
+static int run(bool async) {
+  std::ostringstream out;
+  {
+    std::unique_ptr<qlog::binary_logger> log(async ? new qlog::binary_logger(out, qlog::info, 64)
+                                                   : new qlog::binary_logger(out, qlog::info));
+    std::string const name("qlog");
+    point const p = { 3, -4 };
+    for(int i = 0; i < 2; ++i) {
+      QLOG_BINARY(*log, qlog::info) << "record " << i << ' ' << name << ' ' << 2.5 << ' ' << p;
+      QLOG_BINARY(*log, qlog::debug) << "filtered " << expensive();
+    }
+    QLOG_BINARY(*log, qlog::error) << -7L << ' ' << 18446744073709551615ULL << ' ' << true;
+  }
+  std::string const expected =
+    "[INFO] record 0 qlog 2.5 (3, -4)\n"
+    "[INFO] record 1 qlog 2.5 (3, -4)\n"
+    "[ERROR] -7 18446744073709551615 1\n";
+  std::string const actual = messages(out.str());
+  if(actual != expected || evaluated != 0) {
+    std::cerr << (async ? "async" : "sync") << ": unexpected output" << std::endl << actual;
+    return 1;
+  }
+
+  std::istringstream damaged(out.str().substr(0, out.str().size() - 1));
+  std::ostringstream ignored;
+  if(qlog::decode(damaged, ignored)) {
+    std::cerr << "a truncated stream was decoded" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Returns the text of every line with the timestamp removed.
+ */
+static std::string untimed(std::string const& s) {
+  std::istringstream lines(s);
+  std::string m;
+  std::string line;
+  while(std::getline(lines, line)) {
+    m += line.substr(line.find(' ') + 1) + "\n";
+  }
+  return m;
+}
+
+/**
+ * @brief Fails unless the same records decode to the lines that qlog::logger writes.
+ */
+static int compare_text() {
+  char const* const missing = nullptr;
+  double const third = 1.0 / 3;
+  std::ostringstream text;
+  std::ostringstream binary;
+  {
+    qlog::logger log(text, qlog::info);
+    qlog::binary_logger blog(binary, qlog::info);
+    log(qlog::info) << "doubles " << 0.1 << ' ' << third << ' ' << 2.5 << ' ' << 1e300;
+    QLOG_BINARY(blog, qlog::info) << "doubles " << 0.1 << ' ' << third << ' ' << 2.5 << ' '
+                                  << 1e300;
+    log(qlog::warn) << "string " << missing << ' ' << -42;
+    QLOG_BINARY(blog, qlog::warn) << "string " << missing << ' ' << -42;
+  }
+  std::string const expected = untimed(text.str());
+  std::string const actual = messages(binary.str());
+  if(actual != expected) {
+    std::cerr << "text: expected" << std::endl << expected << "but decoded" << std::endl
+              << actual;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return run(false) || run(true) || compare_text();
+}
@@ -0,0 +1,83 @@
+#include <qlog.hpp>
+#include <sstream>
+#include <string>
+
+static int evaluated = 0;
+
+static std::string expensive(char const* s) {
+  ++evaluated;
+  return s;
+}
+
+static int expect(std::ostringstream& out, char const* what, char const* shown,
+                  char const* hidden) {
+  std::string const s = out.str();
+  if(s.find(shown) == std::string::npos || s.find(hidden) != std::string::npos) {
+    std::cerr << what << ": unexpected output" << std::endl << s;
+    return 1;
+  }
+  out.str("");
+  return 0;
+}
+
+int main() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  qlog::category net(log, "net");
+  qlog::category tls(log, "net.tls");
+  qlog::category db(log, "db");
+
+  // Without any settings, categories follow the log's verbosity.
+  QLOG_INFO(net) << "net info";
+  QLOG_DEBUG(net) << expensive("net debug");
+  log.flush();
+  if(net.level() != QLOG_LEVEL_INHERIT || evaluated != 0 ||
+     expect(out, "inherit", "[INFO] [net] net info\n", "net debug")) {
+    return 1;
+  }
+
+  // A level set for a parent covers its children, and nothing else.
+  qlog::set_category_level("net", qlog::debug);
+  QLOG_DEBUG(tls) << "tls debug";
+  QLOG_DEBUG(db) << expensive("db debug");
+  log.flush();
+  if(tls.level() != QLOG_LEVEL_DEBUG || evaluated != 0 ||
+     expect(out, "parent", "[DEBUG] [net.tls] tls debug\n", "db debug")) {
+    return 1;
+  }
+
+  // A child's own level wins over its parent's, until it is reset.
+  qlog::set_category_level("net.tls", qlog::error);
+  QLOG_WARN(tls) << "tls warn";
+  QLOG_DEBUG(net) << "net debug";
+  log.flush();
+  if(expect(out, "child", "[DEBUG] [net] net debug\n", "tls warn")) {
+    return 1;
+  }
+  qlog::reset_category_level("net.tls");
+  QLOG_DEBUG(tls) << "tls debug again";
+  log.flush();
+  if(expect(out, "reset", "[DEBUG] [net.tls] tls debug again\n", "[ERROR]")) {
+    return 1;
+  }
+
+  // The empty name covers every category, and new categories resolve their level at once.
+  qlog::set_category_level("", qlog::warn);
+  qlog::category cache(log, "db.cache");
+  QLOG_INFO(db) << "db info";
+  QLOG_INFO(cache) << "cache info";
+  QLOG_WARN(cache) << "cache warn";
+  log.flush();
+  if(expect(out, "root", "[WARN] [db.cache] cache warn\n", " info")) {
+    return 1;
+  }
+  log(qlog::info) << "plain info";
+  log.flush();
+  if(expect(out, "uncategorized", "[INFO] plain info\n", "[db")) {
+    return 1;
+  }
+
+  qlog::reset_category_level("");
+  qlog::reset_category_level("net");
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <qlog/binary.hpp>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Returns the wall clock time @p offset seconds from now, with nanosecond digits.
+ */
+static std::string wall(int offset) {
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  t.tv_sec += offset;
+  qlog::timestamp_cache c;
+  char b[qlog::timestamp_cache::max_size];
+  return std::string(b, c.format(t, b, sizeof(b), qlog::timestamp_precision::nanoseconds));
+}
+
+/**
+ * @brief Fails unless every line of @p text starts with a timestamp within a second of now, and
+ *        @p n lines were written.
+ * @param[in] ordered @c true if the timestamps must also never step backwards, which only holds
+ *                    for records read from the same clock.
+ */
+static int expect_times(char const* what, std::string const& text, std::size_t n,
+                        bool ordered) {
+  std::string const earliest = wall(-1);
+  std::string const latest = wall(1);
+  std::istringstream lines(text);
+  std::string line;
+  std::string previous;
+  std::size_t count = 0;
+  while(std::getline(lines, line)) {
+    std::string const t = line.substr(0, line.find_first_of(" \""));
+    if(t < earliest || t > latest || (ordered && t < previous)) {
+      std::cerr << what << ": timestamp " << t << " out of place in" << std::endl << text;
+      return 1;
+    }
+    previous = t;
+    ++count;
+  }
+  if(count != n) {
+    std::cerr << what << ": expected " << n << " lines but got" << std::endl << text;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_anchor() {
+  qlog::detail::clock_anchor const a = { 100, 10, 999999990, 1.0 };
+  qlog::detail::clock_anchor const half = { 1000, 5, 0, 0.5 };
+  struct timespec const later = a.at(120);
+  struct timespec const earlier = a.at(50);
+  struct timespec const scaled = half.at(1000 + 4000000000ULL);
+  if(later.tv_sec != 11 || later.tv_nsec != 10 || earlier.tv_sec != 10 ||
+     earlier.tv_nsec != 999999940 || scaled.tv_sec != 7 || scaled.tv_nsec != 0) {
+    std::cerr << "anchor: unexpected conversion" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_text(char const* what, qlog::clock_policy c) {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    log.set_clock(c).set_precision(qlog::timestamp_precision::nanoseconds);
+    for(int i = 0; i < 100; ++i) {
+      log(qlog::info) << "record " << i;
+    }
+    static qlog::json_encoder const json;
+    log.set_encoder(&json);
+    log(qlog::info) << "encoded";
+  }
+  std::string text = out.str();
+  std::size_t const json = text.rfind("{\"time\":\"");
+  if(json == std::string::npos) {
+    std::cerr << what << ": no encoded record" << std::endl << text;
+    return 1;
+  }
+  text.erase(json, 9);
+  return expect_times(what, text, 101, true);
+}
+
+static int test_binary() {
+  std::ostringstream out;
+  for(int i = 0; i < 2; ++i) {
+    qlog::binary_logger log(out, qlog::info);
+    log.set_clock(qlog::clock_policy::tsc);
+    QLOG_BINARY(log, qlog::info) << "tsc " << 1;
+    QLOG_BINARY(log, qlog::info) << "tsc " << 2;
+    log.set_clock(qlog::clock_policy::monotonic_coarse);
+    QLOG_BINARY(log, qlog::info) << "coarse";
+    log.set_clock(qlog::clock_policy::wall);
+    QLOG_BINARY(log, qlog::info) << "wall";
+  }
+  std::istringstream in(out.str());
+  std::ostringstream text;
+  if(!qlog::decode(in, text, qlog::timestamp_precision::nanoseconds)) {
+    std::cerr << "binary: decode failed" << std::endl << text.str();
+    return 1;
+  }
+  if(text.str().find("UNKNOWN") != std::string::npos ||
+     text.str().find("[INFO] tsc 2\n") == std::string::npos) {
+    std::cerr << "binary: unexpected output" << std::endl << text.str();
+    return 1;
+  }
+  return expect_times("binary", text.str(), 8, false);
+}
+
+int main() {
+  return test_anchor() || test_text("wall", qlog::clock_policy::wall) ||
+         test_text("coarse", qlog::clock_policy::monotonic_coarse) ||
+         test_text("tsc", qlog::clock_policy::tsc) || test_binary();
+}
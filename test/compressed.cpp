@@ -0,0 +1,144 @@
+#include <qlog/compressed_sink.hpp>
+#include <qlog/rotating_file_sink.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Sink that keeps every block written to it apart.
+ */
+class block_sink : public qlog::sink {
+  public:
+    void write(char const* d, std::size_t n) override {
+      blocks.push_back(std::string(d, n));
+      split = true;
+    }
+
+    void write_block(char const* d, std::size_t n) override {
+      blocks.push_back(std::string(d, n));
+    }
+
+    std::vector<std::string> blocks;
+    bool split = false;
+};
+
+/**
+ * @brief Decompresses every gzip member in @p z.
+ * @returns @c false if @p z is not a sequence of whole gzip members.
+ */
+static bool gunzip(std::string const& z, std::string& out) {
+  std::size_t at = 0;
+  while(at < z.size()) {
+    z_stream s;
+    std::memset(&s, 0, sizeof(s));
+    if(inflateInit2(&s, 15 + 16) != Z_OK) {
+      return false;
+    }
+    s.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(z.data() + at));
+    s.avail_in = static_cast<uInt>(z.size() - at);
+    int r;
+    do {
+      char b[4096];
+      s.next_out = reinterpret_cast<Bytef*>(b);
+      s.avail_out = sizeof(b);
+      r = inflate(&s, Z_NO_FLUSH);
+      out.append(b, sizeof(b) - s.avail_out);
+    } while(r == Z_OK);
+    at = z.size() - s.avail_in;
+    inflateEnd(&s);
+    if(r != Z_STREAM_END) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int test_frames() {
+  block_sink out;
+  std::ostringstream plain;
+  {
+    qlog::compressed_sink gzip(out, 4096, std::chrono::milliseconds(0));
+    qlog::ostream_sink copy(plain);
+    qlog::logger log(gzip, qlog::info);
+    log.add_sink(copy, qlog::info);
+    for(int i = 0; i < 1000; ++i) {
+      log(qlog::info) << "request " << i << " finished";
+    }
+  }
+  std::string all;
+  std::size_t compressed = 0;
+  for(std::string const& b : out.blocks) {
+    std::string frame;
+    if(!gunzip(b, frame) || frame.empty() || frame.back() != '\n' || frame.size() > 4096 + 256) {
+      std::cerr << "frames: a frame does not decode on its own" << std::endl;
+      return 1;
+    }
+    all += frame;
+    compressed += b.size();
+  }
+  if(out.split || out.blocks.size() < 5 || all != plain.str() || compressed * 4 > all.size()) {
+    std::cerr << "frames: " << out.blocks.size() << " frames of " << compressed
+              << " bytes do not hold the records" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_interval() {
+  block_sink out;
+  qlog::compressed_sink gzip(out, 1 << 20, std::chrono::milliseconds(1));
+  qlog::logger log(gzip, qlog::info);
+  log(qlog::info) << "first";
+  log.flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  log(qlog::info) << "second";
+  std::string text;
+  if(out.blocks.size() != 1 || !gunzip(out.blocks[0], text) ||
+     text.find("[INFO] first\n") == std::string::npos) {
+    std::cerr << "interval: an old frame was not finished on flush" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_rotation() {
+  char dir[] = "/tmp/qlog-compressed-XXXXXX";
+  if(!mkdtemp(dir)) {
+    return 1;
+  }
+  std::string const path = dir + std::string("/app.log.gz");
+  {
+    qlog::rotating_file_sink file(path, 2048, std::chrono::milliseconds(0), 20);
+    qlog::compressed_sink gzip(file, 2048, std::chrono::milliseconds(0));
+    qlog::logger log(gzip, qlog::info, 64);
+    for(int i = 0; i < 2000; ++i) {
+      log(qlog::info) << "request " << i << " finished";
+    }
+  }
+  int result = 0;
+  std::string last;
+  for(unsigned i = 0; i <= 20; ++i) {
+    std::string const name = i ? path + "." + std::to_string(i) : path;
+    std::ifstream in(name, std::ios::binary);
+    std::string text;
+    if(in && !gunzip(std::string(std::istreambuf_iterator<char>(in), {}), text)) {
+      std::cerr << "rotation: " << name << " is not a whole gzip file" << std::endl;
+      result = 1;
+    }
+    if(i == 0) {
+      last = text;
+    }
+    std::remove(name.c_str());
+  }
+  ::rmdir(dir);
+  if(!result && last.find("[INFO] request 1999 finished\n") == std::string::npos) {
+    std::cerr << "rotation: the last record is missing" << std::endl;
+    result = 1;
+  }
+  return result;
+}
+
+int main() {
+  return test_frames() || test_interval() || test_rotation();
+}
@@ -0,0 +1,86 @@
+#include <qlog.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Returns the text of the last line of @p s after the severity.
+ */
+static std::string last(std::ostringstream const& s) {
+  std::string const text = s.str();
+  std::size_t const end = text.rfind('\n');
+  std::size_t const start = text.rfind('\n', end - 1);
+  std::string const line = text.substr(start == std::string::npos ? 0 : start + 1,
+                                       end - (start == std::string::npos ? 0 : start + 1));
+  return line.substr(line.find("] ") + 2);
+}
+
+static int expect(char const* what, std::string const& actual, std::string const& expected) {
+  if(actual != expected) {
+    std::cerr << what << ": expected " << expected << " but got " << actual << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_text() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  log(qlog::info) << "plain";
+  if(expect("empty", last(out), "plain")) {
+    return 1;
+  }
+
+  qlog::context::set_thread_id();
+  std::string const tid = std::to_string(::syscall(SYS_gettid));
+  int result = 0;
+  {
+    qlog::context_scope request("request", "abc");
+    log(qlog::info) << "started";
+    result |= expect("scope", last(out), "[thread=" + tid + " request=abc] started");
+    {
+      qlog::context_scope inner("request", "a b");
+      log(qlog::info) << "nested";
+      result |= expect("nested", last(out), "[thread=" + tid + " request=\"a b\"] nested");
+    }
+    log(qlog::info) << "restored";
+    result |= expect("restored", last(out), "[thread=" + tid + " request=abc] restored");
+
+    static qlog::category net(log, "net");
+    net(qlog::info) << "category";
+    result |= expect("category", last(out), "[net] [thread=" + tid + " request=abc] category");
+
+    std::thread([&log] {
+      log(qlog::info) << "other thread";
+    }).join();
+    result |= expect("thread", last(out), "other thread");
+  }
+  log(qlog::info) << "ended";
+  result |= expect("ended", last(out), "[thread=" + tid + "] ended");
+  if(qlog::context::get("request") || !qlog::context::erase("thread") ||
+     qlog::context::erase("thread") || !qlog::context::text().empty()) {
+    std::cerr << "erase: the context was not emptied" << std::endl;
+    result = 1;
+  }
+  return result;
+}
+
+static int test_encoded() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  static qlog::json_encoder const json;
+  log.set_encoder(&json);
+  qlog::context_scope request("request", "abc");
+  log(qlog::info).kv("n", 1) << "done";
+  std::string const text = out.str();
+  if(text.find("\"message\":\"done\",\"request\":\"abc\",\"n\":1}") == std::string::npos) {
+    std::cerr << "encoded: unexpected output " << text;
+    return 1;
+  }
+  qlog::context::clear();
+  return 0;
+}
+
+int main() {
+  return test_text() || test_encoded();
+}
@@ -0,0 +1,111 @@
+#include <qlog/control.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static int test_setter() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    log(qlog::debug) << "hidden";
+    log.set_verbosity(qlog::debug);
+    log(qlog::debug) << "shown";
+    log.set_verbosity(qlog::warn);
+    log(qlog::info) << "hidden";
+    if(log.verbosity() != QLOG_LEVEL_WARN || log.enabled(qlog::info)) {
+      std::cerr << "setter: verbosity was not changed" << std::endl;
+      return 1;
+    }
+  }
+  std::string const s = out.str();
+  if(s.find("[DEBUG] shown\n") == std::string::npos || s.find("hidden") != std::string::npos) {
+    std::cerr << "setter: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_signals() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  qlog::verbosity_signals signals(log);
+  ::raise(SIGUSR1);
+  if(log.verbosity() != QLOG_LEVEL_DEBUG) {
+    std::cerr << "signals: SIGUSR1 did not turn on debug" << std::endl;
+    return 1;
+  }
+  ::raise(SIGUSR1);
+  ::raise(SIGUSR1);
+  if(log.verbosity() != QLOG_LEVEL_ALL) {
+    std::cerr << "signals: SIGUSR1 went past qlog::all" << std::endl;
+    return 1;
+  }
+  for(int i = 0; i < 8; ++i) {
+    ::raise(SIGUSR2);
+  }
+  if(log.verbosity() != QLOG_LEVEL_NONE) {
+    std::cerr << "signals: SIGUSR2 did not stop at qlog::none" << std::endl;
+    return 1;
+  }
+  ::raise(SIGUSR1);
+  if(log.verbosity() != QLOG_LEVEL_FATAL) {
+    std::cerr << "signals: SIGUSR1 did not step from qlog::none to qlog::fatal" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static void write_file(std::string const& path, char const* text) {
+  std::ofstream f(path, std::ios::trunc);
+  f << text;
+}
+
+static int test_file(std::string const& dir) {
+  std::string const path = dir + "/level";
+  write_file(path, "  Debug\n");
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  {
+    qlog::control_file control(log, path, std::chrono::milliseconds(0));
+    if(log.verbosity() != QLOG_LEVEL_DEBUG || control.poll()) {
+      std::cerr << "file: the first read did not set debug" << std::endl;
+      return 1;
+    }
+    write_file(path, "not a level");
+    if(control.poll() || log.verbosity() != QLOG_LEVEL_DEBUG) {
+      std::cerr << "file: a bad level was accepted" << std::endl;
+      return 1;
+    }
+    write_file(path, "250");
+    if(!control.poll() || log.verbosity() != 250) {
+      std::cerr << "file: a level number was not accepted" << std::endl;
+      return 1;
+    }
+  }
+  {
+    qlog::control_file control(log, path, std::chrono::milliseconds(5));
+    write_file(path, "error");
+    for(int i = 0; i < 200 && log.verbosity() != QLOG_LEVEL_ERROR; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    if(log.verbosity() != QLOG_LEVEL_ERROR) {
+      std::cerr << "file: the background thread did not re-read the file" << std::endl;
+      return 1;
+    }
+  }
+  std::remove(path.c_str());
+  return 0;
+}
+
+int main() {
+  char dir[] = "/tmp/qlog-control-XXXXXX";
+  if(!::mkdtemp(dir)) {
+    std::cerr << "cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  int const failed = test_setter() || test_signals() || test_file(dir);
+  ::rmdir(dir);
+  return failed;
+}
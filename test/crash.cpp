@@ -0,0 +1,130 @@
+#include <qlog.hpp>
+#include <qlog/crash.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+
+/**
+ * @brief Sink that never finishes a write, so every record stays queued.
+ */
+class stuck_sink : public qlog::sink {
+  public:
+    void write(char const*, std::size_t) override {
+      for(;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+    }
+};
+
+/**
+ * @brief Sink whose records never arrive anywhere.
+ */
+class lost_sink : public qlog::sink {
+  public:
+    void write(char const*, std::size_t) override { }
+};
+
+/**
+ * @brief Runs @p body in a child process that must die on @p signal, and returns what the
+ *        child's crash handler wrote.
+ */
+template<typename Body>
+static bool crash(int signal, Body body, std::string& salvaged) {
+  int fds[2];
+  if(::pipe(fds) != 0) {
+    return false;
+  }
+  pid_t const child = ::fork();
+  if(child == 0) {
+    ::close(fds[0]);
+    body(fds[1]);
+    std::_Exit(0);
+  }
+  ::close(fds[1]);
+  char b[4096];
+  for(ssize_t n; (n = ::read(fds[0], b, sizeof(b))) > 0;) {
+    salvaged.append(b, static_cast<std::size_t>(n));
+  }
+  ::close(fds[0]);
+  int status = 0;
+  ::waitpid(child, &status, 0);
+  return WIFSIGNALED(status) && WTERMSIG(status) == signal;
+}
+
+static std::size_t count(std::string const& s, std::string const& what) {
+  std::size_t n = 0;
+  for(std::size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+static int test_async() {
+  std::string s;
+  bool const died = crash(SIGABRT, [](int fd) {
+    stuck_sink out;
+    qlog::logger log(out, qlog::info, 64);
+    qlog::crash_handler handler(log, fd);
+    for(int i = 0; i < 10; ++i) {
+      log(qlog::info) << "record " << std::to_string(i);
+    }
+    log(qlog::fatal) << "giving up";
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::abort();
+  }, s);
+  if(!died || count(s, "[INFO] record ") != 10 || count(s, "[FATAL] giving up\n") != 1 ||
+     s.find("record 9\n") > s.find("giving up")) {
+    std::cerr << "async: unexpected salvage" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_batched() {
+  std::string s;
+  bool const died = crash(SIGSEGV, [](int fd) {
+    lost_sink out;
+    qlog::logger log(out, qlog::info);
+    log.set_flush_policy(qlog::flush_policy(100));
+    qlog::crash_handler handler(log, fd);
+    log(qlog::info) << "first";
+    log(qlog::info).kv("state", "bad") << "second";
+    ::raise(SIGSEGV);
+  }, s);
+  if(!died || count(s, "\n") != 2 || s.find("[INFO] second state=bad\n") == std::string::npos) {
+    std::cerr << "batched: unexpected salvage" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_routes() {
+  std::string s;
+  bool const died = crash(SIGABRT, [](int fd) {
+    lost_sink out;
+    stuck_sink errors;
+    qlog::logger log(out, qlog::info);
+    log.add_sink(errors, qlog::error, 64);
+    qlog::crash_handler handler(log, fd);
+    log(qlog::error) << "queued for the second sink";
+    static qlog::json_encoder const json;
+    log.set_encoder(&json);
+    qlog::record pending = log(qlog::warn);
+    pending << "pending " << 7;
+    pending.kv("ratio", 0.25);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::abort();
+  }, s);
+  if(!died || count(s, "[ERROR] queued for the second sink\n") != 1 ||
+     count(s, " [WARN] pending 7\n") != 1 || s.find("ratio") != std::string::npos) {
+    std::cerr << "routes: unexpected salvage" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_async() || test_batched() || test_routes();
+}
@@ -0,0 +1,111 @@
+#include <qlog.hpp>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Sink that keeps everything written to it, and can be made to stall.
+ */
+class keeping_sink : public qlog::sink {
+  public:
+    keeping_sink() : _stalled(false) { }
+
+    void write(char const* d, std::size_t n) override {
+      while(_stalled.load()) {
+        std::this_thread::yield();
+      }
+      std::lock_guard<std::mutex> lock(_mutex);
+      _text.append(d, n);
+    }
+
+    std::string text() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _text;
+    }
+
+    void stall(bool s) {
+      _stalled.store(s);
+    }
+
+  private:
+    std::atomic<bool> _stalled;
+    std::mutex _mutex;
+    std::string _text;
+};
+
+static std::size_t count_lines(std::string const& s) {
+  std::size_t n = 0;
+  for(auto c : s) {
+    if(c == '\n') {
+      ++n;
+    }
+  }
+  return n;
+}
+
+static int test_levels() {
+  keeping_sink everything;
+  keeping_sink errors;
+  qlog::logger log(everything, qlog::info);
+  log.add_sink(errors, qlog::error);
+  log(qlog::info) << "started";
+  log(qlog::error) << "failed";
+  log(qlog::debug) << "filtered";
+  log.flush();
+  std::string const all = everything.text();
+  std::string const e = errors.text();
+  if(count_lines(all) != 2 || count_lines(e) != 1 ||
+     e.find("[ERROR] failed\n") == std::string::npos || all.find(e) == std::string::npos) {
+    std::cerr << "levels: unexpected output" << std::endl << all << e;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_isolated() {
+  keeping_sink fast;
+  keeping_sink slow;
+  qlog::logger log(fast, qlog::info);
+  log.add_sink(slow, qlog::info, 4, qlog::overflow_policy::drop_newest);
+  slow.stall(true);
+  for(int i = 0; i < 100; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  log(qlog::info) << "last";
+  // The fast sink is written synchronously while the slow one is stuck.
+  bool const held = count_lines(fast.text()) != 101 || log.dropped() == 0;
+  slow.stall(false);
+  if(held) {
+    std::cerr << "isolated: the slow sink held up the fast one" << std::endl;
+    return 1;
+  }
+  log.flush();
+  std::size_t const n = count_lines(slow.text());
+  if(count_lines(fast.text()) != 101 || n == 0 || n + log.dropped() != 101) {
+    std::cerr << "isolated: " << n << " records and " << log.dropped() << " dropped" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_async() {
+  keeping_sink first;
+  keeping_sink second;
+  {
+    qlog::logger log(first, qlog::all, 64);
+    log.add_sink(second, qlog::warn, 64);
+    for(int i = 0; i < 50; ++i) {
+      log(i % 2 ? qlog::warn : qlog::debug) << "record " << std::to_string(i);
+    }
+  }
+  if(count_lines(first.text()) != 50 || count_lines(second.text()) != 25) {
+    std::cerr << "async: destructor did not drain every queue" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_levels() || test_isolated() || test_async();
+}
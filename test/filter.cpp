@@ -0,0 +1,60 @@
+// Removes debug records at compile time.
+#define QLOG_MIN_LEVEL QLOG_LEVEL_INFO
+#include <qlog.hpp>
+#include <sstream>
+#include <string>
+
+static int evaluated = 0;
+
+static std::string expensive(char const* s) {
+  ++evaluated;
+  return s;
+}
+
+static int test_compile_time() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::all);
+    QLOG_INFO(log) << expensive("kept");
+    QLOG_DEBUG(log) << expensive("removed");
+    if(!evaluated)
+      QLOG_DEBUG(log) << expensive("removed");
+    else
+      QLOG_WARN(log) << expensive("else branch");
+  }
+  std::string const s = out.str();
+  if(evaluated != 2 || s.find("[INFO] kept\n") == std::string::npos ||
+     s.find("[WARN] else branch\n") == std::string::npos ||
+     s.find("removed") != std::string::npos) {
+    std::cerr << "compile time: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_run_time() {
+  evaluated = 0;
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::warn);
+    QLOG(log, qlog::error) << expensive("kept");
+    QLOG(log, qlog::info) << expensive("filtered");
+    QLOG_INFO(log) << expensive("filtered");
+    QLOG_WARN(log) << expensive("kept");
+    if(log.enabled(qlog::debug) || !log.enabled(qlog::warn)) {
+      std::cerr << "run time: enabled() disagrees with the verbosity" << std::endl;
+      return 1;
+    }
+  }
+  std::string const s = out.str();
+  if(evaluated != 2 || s.find("[ERROR] kept\n") == std::string::npos ||
+     s.find("[WARN] kept\n") == std::string::npos || s.find("filtered") != std::string::npos) {
+    std::cerr << "run time: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_compile_time() || test_run_time();
+}
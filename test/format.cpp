@@ -0,0 +1,84 @@
+// Keeps records short so that truncation is easy to trigger.
+#define QLOG_RECORD_SIZE 128
+#include <qlog.hpp>
+#include <climits>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+
+struct point {
+  int x;
+  int y;
+};
+
+static std::ostream& operator<<(std::ostream& o, point const& p) {
+  return o << '(' << p.x << ", " << p.y << ')';
+}
+
+/**
+ * @brief Returns the message of each record, without its timestamp and severity.
+ */
+static std::string messages(std::string const& s) {
+  std::istringstream in(s);
+  std::string m;
+  std::string line;
+  while(std::getline(in, line)) {
+    m += line.substr(line.find("] ") + 2) + "\n";
+  }
+  return m;
+}
+
+int main() {
+  std::ostringstream out;
+  std::string const long_text(200, 'x');
+  std::ostringstream stdout_text;
+  std::streambuf* const stdout_buf = std::cout.rdbuf(stdout_text.rdbuf());
+  {
+    int count = 3;
+    std::string name("lvalue");
+    point p{ 1, 2 };
+    char word[] = "word";
+    qlog::logger log(out);
+    log(qlog::info) << 0 << ' ' << -1 << ' ' << LLONG_MIN << ' ' << ULLONG_MAX << ' '
+                    << static_cast<short>(-32768) << ' ' << 42u;
+    log(qlog::info) << 0.1 << ' ' << 2.5 << ' ' << 100.0 << ' ' << 1.0 / 3 << ' ' << 1e300 << ' '
+                    << -0.0 << ' ' << 0.1f << ' ' << std::numeric_limits<double>::infinity();
+    log(qlog::info) << true << ' ' << 'c' << ' ' << std::string("text") << ' '
+                    << static_cast<char const*>(nullptr) << ' ' << point{ 3, -4 };
+    log(qlog::info) << reinterpret_cast<void const*>(0x1234abcd);
+    log(qlog::info) << std::hex << 255 << ' ' << std::dec << std::setprecision(3) << 3.14159;
+    log(qlog::info) << std::setprecision(6) << std::setw(4) << 7 << '|';
+    log(qlog::info) << count << ' ' << name << ' ' << p << ' ' << word;
+    log(qlog::info) << long_text;
+  }
+  std::cout.rdbuf(stdout_buf);
+  if(!stdout_text.str().empty()) {
+    std::cerr << "values were written to std::cout" << std::endl << stdout_text.str();
+    return 1;
+  }
+
+  std::string const expected =
+    "0 -1 -9223372036854775808 18446744073709551615 -32768 42\n"
+    "0.1 2.5 100 0.3333333333333333 1e+300 -0 0.10000000149011612 inf\n"
+    "1 c text (null) (3, -4)\n"
+    "0x1234abcd\n"
+    "ff 3.14\n"
+    "   7|\n"
+    "3 lvalue (1, 2) word\n";
+  std::string const actual = messages(out.str());
+  std::string const last = actual.substr(expected.size());
+  if(actual.compare(0, expected.size(), expected) != 0) {
+    std::cerr << "unexpected output" << std::endl << actual;
+    return 1;
+  }
+
+  // The whole record, including its timestamp and severity, is cut to QLOG_RECORD_SIZE.
+  std::string const s = out.str();
+  std::size_t const start = s.rfind('\n', s.size() - 2) + 1;
+  if(s.size() - start != QLOG_RECORD_SIZE || last.compare(last.size() - 4, 4, "...\n") != 0) {
+    std::cerr << "expected a truncated record" << std::endl << last;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <qlog/global.hpp>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Sink that keeps everything written to it.
+ */
+class string_sink : public qlog::sink {
+  public:
+    void write(char const* d, std::size_t n) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      text.append(d, n);
+    }
+
+    std::mutex mutex;
+    std::string text;
+};
+
+/** @brief Sink of the process-wide log, once the log has created it. */
+static string_sink* captured = nullptr;
+
+/**
+ * @brief Logs from a static destructor, after the main thread's thread locals, the registries
+ *        and the log's std::atexit handler have all been through their own teardown.
+ *
+ * It is constructed before anything has used the log, so it is destroyed after all of them.
+ */
+struct late_user {
+  ~late_user() {
+    qlog::global_logger()(qlog::info) << "from a static destructor";
+    if(!captured || captured->text.find("from a static destructor\n") == std::string::npos) {
+      std::cerr << "static: the record from a static destructor was lost" << std::endl;
+      std::_Exit(1);
+    }
+  }
+};
+
+static late_user const late;
+
+/**
+ * @brief Configures and uses the process-wide log from a static initializer.
+ */
+struct early_user {
+  early_user() {
+    lazy = qlog::detail::global().log.load() == nullptr;
+    configured = qlog::configure_global_logger([] { return captured = new string_sink; },
+                                               qlog::info, 64);
+    qlog::global_logger()(qlog::info) << "from a static initializer";
+  }
+
+  bool lazy;
+  bool configured;
+};
+
+static early_user const early;
+
+static int expect_count(char const* what, std::string const& text, std::string const& needle,
+                        std::size_t expected) {
+  std::size_t n = 0;
+  for(std::size_t at = text.find(needle); at != std::string::npos;
+      at = text.find(needle, at + 1)) {
+    ++n;
+  }
+  if(n != expected) {
+    std::cerr << what << ": expected " << expected << " of " << needle << " but got " << n
+              << std::endl << text;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  if(!early.lazy || !early.configured || !captured) {
+    std::cerr << "static: the log was not created lazily from the static initializer"
+              << std::endl;
+    return 1;
+  }
+  if(qlog::configure_global_logger(nullptr)) {
+    std::cerr << "configure: changed a log that already exists" << std::endl;
+    return 1;
+  }
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      for(int i = 0; i < 1000; ++i) {
+        QLOG_INFO(qlog::global_logger()) << "from a thread " << i;
+      }
+    });
+  }
+  for(auto& t : threads) {
+    t.join();
+  }
+  QLOG_DEBUG(qlog::global_logger()) << "filtered";
+  qlog::global_logger()(qlog::warn) << "pending";
+  qlog::shutdown();
+  if(expect_count("shutdown", captured->text, "from a static initializer\n", 1) ||
+     expect_count("shutdown", captured->text, "from a thread ", 4000) ||
+     expect_count("shutdown", captured->text, "filtered", 0) ||
+     expect_count("shutdown", captured->text, "pending\n", 1)) {
+    return 1;
+  }
+  qlog::global_logger()(qlog::error) << "after shutdown";
+  qlog::global_logger().flush();
+  qlog::shutdown();
+  return expect_count("after", captured->text, "after shutdown\n", 1);
+}
@@ -0,0 +1,127 @@
+#include <qlog.hpp>
+#include <limits>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Returns the text after the timestamp of the only record in @p out, and empties it.
+ */
+static std::string take(std::ostringstream& out) {
+  std::string const s = out.str();
+  out.str("");
+  std::size_t const space = s.find(' ');
+  return space == std::string::npos ? s : s.substr(space + 1);
+}
+
+static int expect(char const* what, std::string const& got, std::string const& expected) {
+  if(got != expected) {
+    std::cerr << what << ": expected" << std::endl << expected << "but got" << std::endl << got;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_text() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  log(qlog::info).kv("latency_us", 12).kv("path", "/index.html") << "request done";
+  log.flush();
+  if(expect("text", take(out), "[INFO] request done latency_us=12 path=/index.html\n")) {
+    return 1;
+  }
+  std::string const spaced("a b");
+  log(qlog::info).kv("ok", true).kv("ratio", 0.5).kv("name", spaced).kv("empty", "")
+    << "quoted";
+  log(qlog::debug).kv("filtered", 1) << "filtered";
+  log.flush();
+  return expect("quoted", take(out), "[INFO] quoted ok=true ratio=0.5 name=\"a b\" empty=\"\"\n");
+}
+
+static int test_json() {
+  std::ostringstream out;
+  qlog::json_encoder const json;
+  qlog::logger log(out, qlog::info);
+  log.set_encoder(&json);
+  qlog::category net(log, "net");
+  net(qlog::warn).kv("latency_us", -12).kv("bytes", 30UL).kv("path", "/a\"b\\c\n\x01")
+    << "slow \"request\"";
+  log.flush();
+  std::string const s = out.str();
+  out.str("");
+  std::string const expected = "\",\"level\":\"WARN\",\"category\":\"net\","
+    "\"message\":\"slow \\\"request\\\"\",\"latency_us\":-12,\"bytes\":30,"
+    "\"path\":\"/a\\\"b\\\\c\\n\\u0001\"}\n";
+  if(s.compare(0, 9, "{\"time\":\"") != 0 || s.size() < expected.size() ||
+     s.compare(s.size() - expected.size(), expected.size(), expected) != 0) {
+    std::cerr << "json: unexpected output" << std::endl << s;
+    return 1;
+  }
+  log(qlog::info).kv("nan", std::numeric_limits<double>::quiet_NaN()).kv("ok", false) << "values";
+  log.flush();
+  if(out.str().find("\"message\":\"values\",\"nan\":null,\"ok\":false}\n") == std::string::npos) {
+    std::cerr << "json: unexpected values" << std::endl << out.str();
+    return 1;
+  }
+  return 0;
+}
+
+static int test_logfmt() {
+  std::ostringstream out;
+  qlog::logfmt_encoder const logfmt;
+  qlog::logger log(out, qlog::info);
+  log.set_encoder(&logfmt);
+  log(qlog::error).kv("code", 503).kv("reason", "no route") << "failed";
+  log.flush();
+  std::string const s = out.str();
+  if(s.compare(0, 5, "time=") != 0 ||
+     s.find(" level=ERROR msg=failed code=503 reason=\"no route\"\n") == std::string::npos) {
+    std::cerr << "logfmt: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_encoder_text() {
+  std::ostringstream out;
+  qlog::text_encoder const text;
+  qlog::logger log(out, qlog::info);
+  log.set_encoder(&text);
+  qlog::category db(log, "db");
+  db(qlog::info).kv("rows", 3) << "query";
+  log.flush();
+  return expect("text encoder", take(out), "[INFO] [db] query rows=3\n");
+}
+
+static int test_limits() {
+  std::ostringstream out;
+  qlog::logger log(out, qlog::info);
+  {
+    qlog::record r = log(qlog::info);
+    r << "many";
+    for(std::size_t i = 0; i < qlog::record_fields::capacity + 5; ++i) {
+      r.kv("k", 1);
+    }
+  }
+  std::string const s = take(out);
+  std::size_t n = 0;
+  for(std::size_t i = s.find(" k=1"); i != std::string::npos; i = s.find(" k=1", i + 1)) {
+    ++n;
+  }
+  if(n != qlog::record_fields::capacity) {
+    std::cerr << "limits: expected " << qlog::record_fields::capacity << " fields but got " << n
+              << std::endl;
+    return 1;
+  }
+  log(qlog::info).kv("big", std::string(2 * QLOG_RECORD_SIZE, 'x')) << "truncated";
+  log.flush();
+  std::string const t = take(out);
+  if(t.size() > QLOG_RECORD_SIZE || t.compare(t.size() - 4, 4, "...\n") != 0) {
+    std::cerr << "limits: long field was not truncated" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_text() || test_json() || test_logfmt() || test_encoder_text() || test_limits();
+}
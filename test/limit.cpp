@@ -0,0 +1,106 @@
+#include <qlog/rate_limit.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static int evaluated = 0;
+
+static std::string expensive(char const* s) {
+  ++evaluated;
+  return s;
+}
+
+static std::size_t count(std::string const& s, char const* what) {
+  std::size_t n = 0;
+  for(std::size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+template<typename Log>
+static void failing(Log& log) {
+  QLOG_LIMIT_SUMMARY(log, qlog::error, 1, 5, std::chrono::milliseconds(50))
+      << expensive("connect failed");
+}
+
+static int test_logger() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    for(int i = 0; i < 1000; ++i) {
+      failing(log);
+    }
+    if(evaluated != 5) {
+      std::cerr << "logger: " << evaluated << " records were formatted" << std::endl;
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    failing(log);
+  }
+  std::string const s = out.str();
+  if(count(s, "[ERROR] connect failed\n") != 5 ||
+     s.find("[ERROR] suppressed 996 similar messages from ") == std::string::npos ||
+     s.find("limit.cpp:") == std::string::npos) {
+    std::cerr << "logger: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_refill() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    for(int i = 0; i < 4; ++i) {
+      QLOG_LIMIT(log, qlog::warn, 50, 1) << "tick";
+      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    }
+    QLOG_LIMIT(log, qlog::debug, 50, 1) << expensive("filtered");
+  }
+  std::string const s = out.str();
+  if(count(s, "[WARN] tick\n") != 4 || s.find("filtered") != std::string::npos) {
+    std::cerr << "refill: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_category() {
+  evaluated = 0;
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    qlog::category net(log, "net");
+    for(int i = 0; i < 100; ++i) {
+      failing(net);
+    }
+  }
+  std::string const s = out.str();
+  if(evaluated != 5 || count(s, "[ERROR] [net] connect failed\n") != 5) {
+    std::cerr << "category: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_no_rate() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    for(int i = 0; i < 100; ++i) {
+      QLOG_LIMIT(log, qlog::warn, 0, 10) << "zero";
+      QLOG_LIMIT(log, qlog::warn, 1e-300, 1000) << "tiny";
+    }
+  }
+  std::string const s = out.str();
+  if(count(s, "[WARN] zero\n") != 10 || count(s, "[WARN] tiny\n") != 100) {
+    std::cerr << "no rate: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_logger() || test_refill() || test_category() || test_no_rate();
+}
@@ -0,0 +1,136 @@
+#define QLOG_COUNT_FILTERED 1
+#include <qlog.hpp>
+#include <qlog/metrics.hpp>
+#include <qlog/rate_limit.hpp>
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Sink that counts the bytes written to it, and can be made to stall.
+ */
+class counting_sink : public qlog::sink {
+  public:
+    counting_sink() : _stalled(false), _bytes(0) { }
+
+    void write(char const*, std::size_t n) override {
+      while(_stalled.load()) {
+        std::this_thread::yield();
+      }
+      _bytes.fetch_add(n);
+    }
+
+    std::size_t bytes() const {
+      return _bytes.load();
+    }
+
+    void stall(bool s) {
+      _stalled.store(s);
+    }
+
+  private:
+    std::atomic<bool> _stalled;
+    std::atomic<std::size_t> _bytes;
+};
+
+static int fail(char const* what) {
+  std::cerr << what << std::endl;
+  return 1;
+}
+
+static int test_counts() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+  static qlog::category net(log, "net");
+  qlog::severity_t const notice(350, "NOTICE");
+  for(int i = 0; i < 3; ++i) {
+    QLOG_INFO(log) << "info " << i;
+    QLOG_DEBUG(log) << "filtered " << i;
+  }
+  log(qlog::error) << "failed";
+  QLOG(log, notice) << "custom";
+  QLOG_DEBUG(net) << "filtered";
+  std::thread([&log] {
+    QLOG_WARN(log) << "from another thread";
+  }).join();
+  log.flush();
+
+  qlog::log_metrics const m = log.metrics();
+  if(m.emitted[qlog::log_metrics::slot(QLOG_LEVEL_INFO)] != 4 ||
+     m.emitted[qlog::log_metrics::slot(QLOG_LEVEL_ERROR)] != 1 ||
+     m.emitted[qlog::log_metrics::slot(QLOG_LEVEL_WARN)] != 1 ||
+     m.filtered[qlog::log_metrics::slot(QLOG_LEVEL_DEBUG)] != 4) {
+    return fail("counts: wrong record counts");
+  }
+  if(m.bytes != out.bytes() || m.dropped != 0 || m.queue_high_water != 0) {
+    return fail("counts: wrong bytes or drops");
+  }
+  unsigned long long writes = 0;
+  for(std::size_t i = 0; i < qlog::log_metrics::buckets; ++i) {
+    writes += m.latency[i];
+  }
+  if(m.writes == 0 || writes != m.writes) {
+    return fail("counts: wrong write latency histogram");
+  }
+  return 0;
+}
+
+static int test_drops() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info, 4, qlog::overflow_policy::drop_newest);
+  out.stall(true);
+  for(int i = 0; i < 50; ++i) {
+    log(qlog::info) << "record " << i;
+  }
+  log(qlog::info) << "last";
+  out.stall(false);
+  log.flush();
+  qlog::log_metrics const m = log.metrics();
+  if(m.dropped == 0 || m.dropped != log.dropped() || m.queue_high_water < 4 ||
+     m.emitted[qlog::log_metrics::slot(QLOG_LEVEL_INFO)] != 51) {
+    return fail("drops: wrong drop or queue counts");
+  }
+
+  for(int i = 0; i < 10; ++i) {
+    QLOG_LIMIT(log, qlog::warn, 1, 2) << "limited";
+  }
+  if(log.metrics().suppressed != 8) {
+    return fail("drops: wrong suppressed count");
+  }
+  return 0;
+}
+
+static int test_prometheus() {
+  qlog::log_metrics m;
+  m.emitted[qlog::log_metrics::slot(QLOG_LEVEL_INFO)] = 7;
+  m.latency[0] = 2;
+  m.latency[3] = 1;
+  m.writes = 3;
+  m.write_nanoseconds = 9000;
+  std::ostringstream o;
+  qlog::write_prometheus(o, m, "app");
+  std::string const text = o.str();
+  char const* const expected[] = {
+    "# TYPE app_records_total counter\n",
+    "app_records_total{level=\"info\"} 7\n",
+    "app_filtered_total{level=\"debug\"} 0\n",
+    "app_sink_write_seconds_bucket{le=\"1e-06\"} 2\n",
+    "app_sink_write_seconds_bucket{le=\"4e-06\"} 2\n",
+    "app_sink_write_seconds_bucket{le=\"8e-06\"} 3\n",
+    "app_sink_write_seconds_bucket{le=\"+Inf\"} 3\n",
+    "app_sink_write_seconds_sum 9e-06\n",
+    "app_sink_write_seconds_count 3\n"
+  };
+  for(char const* e : expected) {
+    if(text.find(e) == std::string::npos) {
+      std::cerr << "prometheus: missing " << e << text;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  return test_counts() || test_drops() || test_prometheus();
+}
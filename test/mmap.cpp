@@ -0,0 +1,78 @@
+#include <qlog/mmap_sink.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+
+static std::string read_file(std::string const& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+static std::string records(int first, int last) {
+  std::string s;
+  for(int i = first; i < last; ++i) {
+    s += "record " + std::to_string(i) + "\n";
+  }
+  return s;
+}
+
+static void write_records(qlog::sink& s, int first, int last) {
+  for(int i = first; i < last; ++i) {
+    std::string const r = "record " + std::to_string(i) + "\n";
+    s.write(r.data(), r.size());
+  }
+}
+
+int main() {
+  char dir[] = "/tmp/qlog-mmap-XXXXXX";
+  if(!mkdtemp(dir)) {
+    return 1;
+  }
+  std::string const path = std::string(dir) + "/mmap.log";
+  int result = 0;
+
+  // Spans several chunks, then appends to the file that was closed cleanly.
+  {
+    qlog::mmap_sink file(path, 4096, qlog::msync_policy::async);
+    write_records(file, 0, 1000);
+    file.flush();
+  }
+  {
+    qlog::mmap_sink file(path, 4096);
+    write_records(file, 1000, 1100);
+  }
+  if(read_file(path) != records(0, 1100)) {
+    std::cerr << "clean: the file does not hold exactly the records written" << std::endl;
+    result = 1;
+  }
+
+  // A process that dies without closing the sink leaves its records in the page cache.
+  pid_t const child = fork();
+  if(child == 0) {
+    qlog::mmap_sink* file = new qlog::mmap_sink(path, 4096);
+    write_records(*file, 1100, 1200);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  {
+    qlog::mmap_sink file(path, 4096);
+    qlog::logger log(file);
+    log(qlog::info) << "after";
+  }
+  std::string const s = read_file(path);
+  std::string const expected = records(0, 1200);
+  if(s.compare(0, expected.size(), expected) != 0 ||
+     s.find("[INFO] after\n", expected.size()) == std::string::npos ||
+     s.find('\0') != std::string::npos) {
+    std::cerr << "crash: records were lost or the file has a gap" << std::endl;
+    result = 1;
+  }
+
+  std::remove(path.c_str());
+  ::rmdir(dir);
+  return result;
+}
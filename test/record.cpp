@@ -0,0 +1,139 @@
+#include <qlog.hpp>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Sink that keeps everything written to it and counts the calls to write().
+ */
+class counting_sink : public qlog::sink {
+  public:
+    counting_sink() : _writes(0) { }
+
+    void write(char const* d, std::size_t n) override {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _text.append(d, n);
+      ++_writes;
+    }
+
+    std::string text() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _text;
+    }
+
+    std::size_t writes() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _writes;
+    }
+
+  private:
+    std::mutex _mutex;
+    std::string _text;
+    std::size_t _writes;
+};
+
+static qlog::record started(qlog::logger& log) {
+  qlog::record r = log(qlog::warn);
+  r << "started ";
+  return r;
+}
+
+static int answer(qlog::logger& log) {
+  log(qlog::debug) << "inner";
+  return 42;
+}
+
+/**
+ * @brief Checks that a record started while another is open leaves the open one whole.
+ */
+static int test_nested() {
+  counting_sink out;
+  qlog::logger log(out, qlog::all);
+  log(qlog::info) << "outer " << answer(log) << " end";
+  std::string const nested = out.text();
+  if(out.writes() != 2 || nested.find("[DEBUG] inner\n") == std::string::npos ||
+     nested.find("[INFO] outer 42 end\n") == std::string::npos) {
+    std::cerr << "nested: unexpected output" << std::endl << nested;
+    return 1;
+  }
+
+  // A record held across statements keeps its text while other records come and go, on this
+  // log and on another one.
+  counting_sink other_out;
+  qlog::logger other(other_out, qlog::all);
+  {
+    qlog::record r = log(qlog::info);
+    r << "a ";
+    log(qlog::warn) << "mid";
+    other(qlog::error) << "elsewhere";
+    r << "b";
+    if(out.writes() != 3 || other_out.writes() != 1) {
+      std::cerr << "held: the records were not written as they ended" << std::endl;
+      return 1;
+    }
+  }
+  std::string const held = out.text().substr(nested.size());
+  std::size_t const mid = held.find("[WARN] mid\n");
+  std::size_t const whole = held.find("[INFO] a b\n");
+  if(out.writes() != 4 || mid == std::string::npos || whole == std::string::npos || whole < mid ||
+     other_out.text().find("[ERROR] elsewhere\n") == std::string::npos) {
+    std::cerr << "held: unexpected output" << std::endl << held << other_out.text();
+    return 1;
+  }
+
+  // Once the nested records are done, the thread's records work as before.
+  log(qlog::info) << "after";
+  if(out.writes() != 5 || out.text().find("[INFO] after\n") == std::string::npos) {
+    std::cerr << "after: unexpected output" << std::endl << out.text();
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  counting_sink out;
+  qlog::logger log(out, qlog::info);
+
+  // Each statement is written as it ends, without waiting for the next record or a flush.
+  log(qlog::info) << "first";
+  if(out.writes() != 1 || out.text().find("[INFO] first\n") == std::string::npos) {
+    std::cerr << "statement: the record was not written at its end" << std::endl;
+    return 1;
+  }
+
+  // A record kept in a variable is written once, when it goes out of scope.
+  {
+    qlog::record r = log(qlog::info);
+    for(int i = 0; i < 3; ++i) {
+      r << std::to_string(i) << ' ';
+    }
+    if(out.writes() != 1) {
+      std::cerr << "scope: the record was written too early" << std::endl;
+      return 1;
+    }
+  }
+  if(out.writes() != 2 || out.text().find("[INFO] 0 1 2 \n") == std::string::npos) {
+    std::cerr << "scope: unexpected output" << std::endl << out.text();
+    return 1;
+  }
+
+  // Moving a record hands it over without writing it twice.
+  {
+    qlog::record r = started(log);
+    qlog::record moved(std::move(r));
+    moved << "and moved";
+  }
+  if(out.writes() != 3 || out.text().find("[WARN] started and moved\n") == std::string::npos) {
+    std::cerr << "move: unexpected output" << std::endl << out.text();
+    return 1;
+  }
+
+  // A filtered record writes nothing.
+  log(qlog::debug) << "filtered";
+  log.flush();
+  if(out.writes() != 3) {
+    std::cerr << "filtered: a filtered record was written" << std::endl;
+    return 1;
+  }
+  return test_nested();
+}
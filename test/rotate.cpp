@@ -0,0 +1,82 @@
+#include <qlog/rotating_file_sink.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+static std::size_t file_size(std::string const& path) {
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 ? static_cast<std::size_t>(st.st_size) : 0;
+}
+
+static bool exists(std::string const& path) {
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0;
+}
+
+static int test_size(std::string const& dir) {
+  std::string const path = dir + "/size.log";
+  {
+    qlog::rotating_file_sink file(path, 1024, std::chrono::milliseconds(0), 3);
+    qlog::logger log(file, qlog::all, 64);
+    for(int i = 0; i < 200; ++i) {
+      log(qlog::info) << "record " << std::to_string(i);
+    }
+  }
+  if(!exists(path) || !exists(path + ".1") || !exists(path + ".3") || exists(path + ".4")) {
+    std::cerr << "size: expected the current file and exactly three archives" << std::endl;
+    return 1;
+  }
+  std::string last;
+  std::ifstream in(path);
+  std::string line;
+  while(std::getline(in, line)) {
+    last = line;
+  }
+  if(file_size(path) > 1024 || file_size(path + ".1") > 1024 ||
+     last.find("[INFO] record 199") == std::string::npos) {
+    std::cerr << "size: a file is too large or the last record is missing" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_time(std::string const& dir) {
+  std::string const path = dir + "/time.log";
+  {
+    qlog::rotating_file_sink file(path, 0, std::chrono::milliseconds(20), 2);
+    qlog::logger log(file);
+    log(qlog::info) << "first";
+    log.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    log(qlog::info) << "second";
+  }
+  std::ifstream current(path);
+  std::ifstream archived(path + ".1");
+  std::string a;
+  std::string b;
+  std::getline(current, a);
+  std::getline(archived, b);
+  if(a.find("second") == std::string::npos || b.find("first") == std::string::npos) {
+    std::cerr << "time: expected the first record to be archived" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  char dir[] = "/tmp/qlog-rotate-XXXXXX";
+  if(!mkdtemp(dir)) {
+    return 1;
+  }
+  int const result = test_size(dir) || test_time(dir);
+  for(auto const name : { "/size.log", "/time.log" }) {
+    std::string const path = dir + std::string(name);
+    std::remove(path.c_str());
+    for(unsigned i = 1; i <= 3; ++i) {
+      std::remove((path + "." + std::to_string(i)).c_str());
+    }
+  }
+  ::rmdir(dir);
+  return result;
+}
@@ -0,0 +1,94 @@
+#include <qlog/sample.hpp>
+#include <sstream>
+#include <string>
+
+static int evaluated = 0;
+
+static int expensive() {
+  return ++evaluated;
+}
+
+static std::size_t count(std::string const& s, char const* what) {
+  std::size_t n = 0;
+  for(std::size_t i = s.find(what); i != std::string::npos; i = s.find(what, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+static int test_every() {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::all);
+    qlog::severity_t const trace(QLOG_LEVEL_DEBUG, "TRACE", 10);
+    for(int i = 0; i < 1000; ++i) {
+      int const n = i;
+      QLOG_SAMPLE_EVERY(log, qlog::debug, 100) << "every " << n << ' ' << expensive();
+      QLOG_SAMPLE(log, trace) << "trace";
+      QLOG_SAMPLE(log, qlog::info) << "info";
+    }
+  }
+  std::string const s = out.str();
+  if(evaluated != 10 || count(s, "[DEBUG] every") != 10 ||
+     s.find("[DEBUG] every 0 ") == std::string::npos || count(s, "[TRACE] trace\n") != 100 ||
+     count(s, "[INFO] info\n") != 1000) {
+    std::cerr << "every: unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_chance() {
+  evaluated = 0;
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::info);
+    for(int i = 0; i < 10000; ++i) {
+      QLOG_SAMPLE_CHANCE(log, qlog::info, 0.1) << "tenth";
+      QLOG_SAMPLE_CHANCE(log, qlog::info, 0.0) << "never " << expensive();
+      QLOG_SAMPLE_CHANCE(log, qlog::debug, 1.0) << "filtered " << expensive();
+    }
+  }
+  std::string const s = out.str();
+  std::size_t const n = count(s, "[INFO] tenth\n");
+  if(n < 700 || n > 1300 || evaluated != 0) {
+    std::cerr << "chance: kept " << n << " of 10000 at 0.1" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_key() {
+  std::ostringstream out;
+  std::size_t kept = 0;
+  {
+    qlog::logger log(out, qlog::info);
+    for(std::uint64_t id = 0; id < 1000; ++id) {
+      if(qlog::sample_key(id, 10)) {
+        ++kept;
+      }
+      QLOG_SAMPLE_KEY(log, qlog::info, id, 10) << "start " << std::to_string(id);
+      QLOG_SAMPLE_KEY(log, qlog::info, id, 10) << "end " << std::to_string(id);
+      QLOG_SAMPLE_KEY(log, qlog::info, "request-" + std::to_string(id), 1) << "all";
+    }
+  }
+  std::string const s = out.str();
+  if(kept < 50 || kept > 150 || count(s, "] start ") != kept || count(s, "] end ") != kept ||
+     count(s, "] all\n") != 1000) {
+    std::cerr << "key: unexpected output for " << kept << " kept requests" << std::endl;
+    return 1;
+  }
+  for(std::uint64_t id = 0; id < 1000; ++id) {
+    bool const start = s.find("start " + std::to_string(id) + "\n") != std::string::npos;
+    bool const end = s.find("end " + std::to_string(id) + "\n") != std::string::npos;
+    if(start != end || start != qlog::sample_key(id, 10)) {
+      std::cerr << "key: request " << id << " was split" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  return test_every() || test_chance() || test_key();
+}
@@ -0,0 +1,42 @@
+#include <qlog.hpp>
+#include <sstream>
+#include <string>
+
+constexpr qlog::severity_t notice(350, "NOTICE");
+constexpr qlog::severity_t verbose(450, "A_SEVERITY_WITH_A_VERY_LONG_NAME");
+
+static_assert(qlog::fatal < qlog::error && qlog::debug >= qlog::info, "levels are ordered");
+static_assert(qlog::warn < notice && notice <= qlog::info && notice != qlog::info,
+              "a custom level compares like the others");
+static_assert(qlog::info.name_size == 4 && qlog::info.prefix_size == 8, "prefix of INFO");
+static_assert(qlog::info.prefix[1] == '[' && qlog::info.prefix[6] == ']', "prefix of INFO");
+static_assert(verbose.prefix_size == 0, "a long name has no prefix");
+
+/** @brief Level that is only known when the program runs. */
+static qlog::severity_t const runtime(std::string("9").size() * 100, "LATE");
+
+int main() {
+  if(std::string(qlog::info.prefix, qlog::info.prefix_size) != " [INFO] " ||
+     std::string(notice.prefix, notice.prefix_size) != " [NOTICE] ") {
+    std::cerr << "unexpected prefix" << std::endl;
+    return 1;
+  }
+
+  std::ostringstream out;
+  {
+    qlog::logger log(out, notice);
+    log(notice) << "custom";
+    log(verbose) << "filtered";
+    log.set_verbosity(qlog::all);
+    log(verbose) << "long";
+    log(runtime) << "late";
+  }
+  std::string const s = out.str();
+  if(s.find(" [NOTICE] custom\n") == std::string::npos ||
+     s.find(" [A_SEVERITY_WITH_A_VERY_LONG_NAME] long\n") == std::string::npos ||
+     s.find(" [LATE] late\n") == std::string::npos || s.find("filtered") != std::string::npos) {
+    std::cerr << "unexpected output" << std::endl << s;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <qlog/span.hpp>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Returns the value of the field @p key in @p line, or -1 if it has none.
+ */
+static long long field(std::string const& line, std::string const& key) {
+  std::size_t const at = line.find(" " + key + "=");
+  return at == std::string::npos ? -1 : std::atoll(line.c_str() + at + key.size() + 2);
+}
+
+static int test_nested(char const* what, qlog::clock_policy c) {
+  std::ostringstream out;
+  {
+    qlog::logger log(out, qlog::debug);
+    log.set_clock(c);
+    qlog::span outer(log, qlog::debug, "outer");
+    {
+      qlog::span inner(log, qlog::info, "inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    qlog::span filtered(log, qlog::all, "filtered");
+    if(filtered.elapsed() != 0) {
+      std::cerr << what << ": a filtered span was timed" << std::endl;
+      return 1;
+    }
+  }
+  std::istringstream lines(out.str());
+  std::string inner;
+  std::string outer;
+  std::string extra;
+  std::getline(lines, inner);
+  std::getline(lines, outer);
+  long long const inner_ns = field(inner, "duration_ns");
+  long long const outer_ns = field(outer, "duration_ns");
+  if(std::getline(lines, extra) || inner.find("[INFO] inner ") == std::string::npos ||
+     outer.find("[DEBUG] outer ") == std::string::npos || field(inner, "depth") != 2 ||
+     field(outer, "depth") != 1 || inner_ns < 1500000 || inner_ns > 1000000000 ||
+     outer_ns < inner_ns) {
+    std::cerr << what << ": unexpected output" << std::endl << out.str();
+    return 1;
+  }
+  return 0;
+}
+
+static int test_trace() {
+  std::ostringstream log_text;
+  std::ostringstream out;
+  {
+    qlog::chrome_trace trace(out);
+    qlog::logger log(log_text, qlog::debug);
+    qlog::span outer(log, qlog::debug, "outer", &trace);
+    qlog::span inner(log, qlog::debug, "in\"ner", &trace);
+  }
+  std::string const text = out.str();
+  if(text.compare(0, 3, "[\n{") != 0 || text.find("\n]\n") != text.size() - 3 ||
+     text.find("{\"name\":\"in\\\"ner\",\"cat\":\"qlog\",\"ph\":\"X\",\"ts\":") ==
+       std::string::npos ||
+     text.find(",\"args\":{\"depth\":2}},\n{\"name\":\"outer\"") == std::string::npos) {
+    std::cerr << "trace: unexpected output" << std::endl << text;
+    return 1;
+  }
+
+  std::ostringstream empty;
+  {
+    qlog::chrome_trace trace(empty);
+  }
+  if(empty.str() != "[\n]\n") {
+    std::cerr << "trace: unexpected empty trace " << empty.str() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  return test_nested("wall", qlog::clock_policy::wall) ||
+         test_nested("tsc", qlog::clock_policy::tsc) || test_trace();
+}
@@ -0,0 +1,193 @@
+#include <qlog.hpp>
+#include <qlog/syslog_sink.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Datagram socket bound to a local address that collects what the sinks send.
+ */
+class receiver {
+  public:
+    /**
+     * @brief Binds to a free UDP port on the loopback interface.
+     */
+    receiver() : _port(0) {
+      _fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      struct sockaddr_in a;
+      std::memset(&a, 0, sizeof(a));
+      a.sin_family = AF_INET;
+      a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t n = sizeof(a);
+      if(::bind(_fd, reinterpret_cast<struct sockaddr*>(&a), sizeof(a)) == 0 &&
+         ::getsockname(_fd, reinterpret_cast<struct sockaddr*>(&a), &n) == 0) {
+        _port = ntohs(a.sin_port);
+      }
+    }
+
+    /**
+     * @brief Binds to a Unix domain socket at @p path.
+     */
+    explicit receiver(std::string const& path) : _path(path), _port(0) {
+      ::unlink(path.c_str());
+      _fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      struct sockaddr_un a;
+      std::memset(&a, 0, sizeof(a));
+      a.sun_family = AF_UNIX;
+      std::strncpy(a.sun_path, path.c_str(), sizeof(a.sun_path) - 1);
+      ::bind(_fd, reinterpret_cast<struct sockaddr*>(&a), sizeof(a));
+    }
+
+    ~receiver() {
+      ::close(_fd);
+      if(!_path.empty()) {
+        ::unlink(_path.c_str());
+      }
+    }
+
+    unsigned short port() const {
+      return _port;
+    }
+
+    /**
+     * @brief Returns every datagram that has arrived.
+     */
+    std::vector<std::string> take() {
+      std::vector<std::string> all;
+      char b[65536];
+      for(;;) {
+        ssize_t const n = ::recv(_fd, b, sizeof(b), MSG_DONTWAIT);
+        if(n < 0) {
+          return all;
+        }
+        all.emplace_back(b, static_cast<std::size_t>(n));
+      }
+    }
+
+  private:
+    std::string _path;
+    int _fd;
+    unsigned short _port;
+};
+
+static int fail(char const* what, std::vector<std::string> const& got) {
+  std::cerr << what << ": unexpected datagrams" << std::endl;
+  for(auto const& d : got) {
+    std::cerr << "<" << d << ">" << std::endl;
+  }
+  return 1;
+}
+
+static int test_udp() {
+  receiver in;
+  qlog::udp_sink out("127.0.0.1", in.port(), 100);
+  if(!out.is_open()) {
+    std::cerr << "udp: could not connect" << std::endl;
+    return 1;
+  }
+  qlog::logger log(out, qlog::info);
+  log.set_flush_policy(qlog::flush_policy(10));
+  for(int i = 0; i < 10; ++i) {
+    log(qlog::info) << "record " << std::to_string(i);
+  }
+  log.flush();
+  std::vector<std::string> const got = in.take();
+  std::string all;
+  for(auto const& d : got) {
+    if(d.size() > 100 || d.back() != '\n') {
+      return fail("udp", got);
+    }
+    all += d;
+  }
+  // Each record is about 40 bytes, so two fit in a datagram.
+  if(got.size() != 5 || all.find("[INFO] record 9\n") == std::string::npos) {
+    return fail("udp", got);
+  }
+  return 0;
+}
+
+static int test_syslog() {
+  receiver in;
+  qlog::syslog_sink out("qlog-test", "127.0.0.1", in.port(), 16);
+  qlog::logger log(out, qlog::info);
+  log.set_precision(qlog::timestamp_precision::nanoseconds);
+  log(qlog::error) << "failed";
+  log(qlog::info) << "done";
+  log.flush();
+  std::vector<std::string> const got = in.take();
+  std::string const tail = " qlog-test " + std::to_string(::getpid()) + " - - ";
+  if(got.size() != 2 || got[0].compare(0, 8, "<131>1 2") != 0 ||
+     got[0].find(tail + "failed") == std::string::npos || got[0].find("Z ") != 33 ||
+     got[1].compare(0, 8, "<134>1 2") != 0 || got[1].find(tail + "done") == std::string::npos) {
+    return fail("syslog", got);
+  }
+  return 0;
+}
+
+/** @brief Custom severity between qlog::warn and qlog::info. */
+constexpr qlog::severity_t notice(350, "NOTICE");
+
+static int test_levels() {
+  receiver in;
+  qlog::syslog_sink out("qlog-test", "127.0.0.1", in.port(), 16);
+  qlog::logger log(out, qlog::all, 16);
+  log(notice) << "custom";
+  log(qlog::warn) << "first line\nsecond line";
+  static qlog::json_encoder const json;
+  log.set_encoder(&json);
+  log(qlog::error) << "retry [3] failed";
+  log.flush();
+  std::vector<std::string> const got = in.take();
+  // An encoded record has no timestamp the sink can use, so all of it is the message.
+  std::string const tail = " qlog-test " + std::to_string(::getpid()) + " - - ";
+  if(got.size() != 3 || got[0].compare(0, 8, "<133>1 2") != 0 ||
+     got[0].find(" - - custom") == std::string::npos || got[1].compare(0, 8, "<132>1 2") != 0 ||
+     got[1].find(" - - first line\nsecond line") == std::string::npos ||
+     got[2].compare(0, 9, "<131>1 - ") != 0 ||
+     got[2].find(tail + "{\"time\":\"") == std::string::npos ||
+     got[2].find("\"message\":\"retry [3] failed\"}") == std::string::npos) {
+    return fail("levels", got);
+  }
+  return 0;
+}
+
+static int test_journald() {
+  std::string const path = "/tmp/qlog-journal-" + std::to_string(::getpid());
+  receiver in(path);
+  qlog::journald_sink out("qlog-test", path);
+  if(!out.is_open()) {
+    std::cerr << "journald: could not connect" << std::endl;
+    return 1;
+  }
+  qlog::logger log(out, qlog::info);
+  log(qlog::warn) << "careful";
+  log(qlog::error) << "two\nlines";
+  static qlog::json_encoder const json;
+  log.set_encoder(&json);
+  log(qlog::info) << "retry [3] failed";
+  log.flush();
+  std::vector<std::string> const got = in.take();
+  std::string const fields = "\nSYSLOG_IDENTIFIER=qlog-test\nSYSLOG_PID=" +
+                             std::to_string(::getpid()) + "\n";
+  std::string const encoded = "PRIORITY=6" + fields + "MESSAGE={\"time\":\"";
+  if(got.size() != 3 || got[0] != "PRIORITY=4" + fields + "MESSAGE=careful\n" ||
+     got[1] != "PRIORITY=3" + fields + "MESSAGE\n" + std::string("\x09\0\0\0\0\0\0\0", 8) +
+               "two\nlines\n" || got[2].compare(0, encoded.size(), encoded) != 0 ||
+     got[2].find("\"message\":\"retry [3] failed\"}\n") == std::string::npos) {
+    return fail("journald", got);
+  }
+  return 0;
+}
+
+static int test_closed() {
+  qlog::syslog_sink out("qlog-test", "/nonexistent/qlog.sock");
+  qlog::logger log(out, qlog::info);
+  log(qlog::info) << "lost";
+  log.flush();
+  return out.is_open() ? 1 : 0;
+}
+
+int main() {
+  return test_udp() || test_syslog() || test_levels() || test_journald() || test_closed();
+}
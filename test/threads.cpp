@@ -0,0 +1,65 @@
+#include <qlog.hpp>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int const threads = 8;
+static int const records = 2000;
+
+static void produce(qlog::logger& log, int t) {
+  for(int i = 0; i < records; ++i) {
+    log(qlog::info) << "thread " << std::to_string(t) << " record " << std::to_string(i) << " end";
+    log(qlog::debug) << "filtered";
+  }
+}
+
+/**
+ * @brief Checks that every line is complete and that each thread's records arrived in order.
+ */
+static int check(std::string const& s, char const* mode) {
+  std::vector<int> next(threads, 0);
+  std::istringstream in(s);
+  std::string line;
+  while(std::getline(in, line)) {
+    int t = -1;
+    int i = -1;
+    char end[4] = { 0 };
+    std::size_t const p = line.find(" [INFO] ");
+    if(p == std::string::npos ||
+       sscanf(line.c_str() + p, " [INFO] thread %d record %d %3s", &t, &i, end) != 3 ||
+       std::string(end) != "end" || t < 0 || t >= threads || next[t] != i) {
+      std::cerr << mode << ": malformed or out of order line: " << line << std::endl;
+      return 1;
+    }
+    ++next[t];
+  }
+  for(int t = 0; t < threads; ++t) {
+    if(next[t] != records) {
+      std::cerr << mode << ": thread " << t << " wrote " << next[t] << " records" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int run(bool async) {
+  std::ostringstream out;
+  {
+    std::unique_ptr<qlog::logger> log(async ? new qlog::logger(out, qlog::info, 256)
+                                            : new qlog::logger(out, qlog::info));
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; ++t) {
+      pool.emplace_back(produce, std::ref(*log), t);
+    }
+    for(auto& t : pool) {
+      t.join();
+    }
+  }
+  return check(out.str(), async ? "async" : "sync");
+}
+
+int main() {
+  return run(false) || run(true);
+}
@@ -0,0 +1,35 @@
+#include <qlog.hpp>
+#include <string>
+
+static int expect(qlog::timestamp_cache& c, time_t s, long ns, qlog::timestamp_precision p,
+                  char const* expected) {
+  struct timespec t;
+  t.tv_sec = s;
+  t.tv_nsec = ns;
+  char b[qlog::timestamp_cache::max_size];
+  std::size_t const n = c.format(t, b, sizeof(b), p);
+  if(std::string(b, n) != expected || b[n] != '\0') {
+    std::cerr << "expected " << expected << " but got " << std::string(b, n) << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  using qlog::timestamp_precision;
+  qlog::timestamp_cache c;
+  char small[25];
+  qlog::logger log;
+  return expect(c, 0, 5000000, timestamp_precision::milliseconds, "1970-01-01T00:00:00.005Z") ||
+         expect(c, 0, 5000000, timestamp_precision::microseconds, "1970-01-01T00:00:00.005000Z") ||
+         expect(c, 0, 5000001, timestamp_precision::nanoseconds,
+                "1970-01-01T00:00:00.005000001Z") ||
+         expect(c, 86399, 999999999, timestamp_precision::milliseconds,
+                "1970-01-01T23:59:59.999Z") ||
+         expect(c, 86400, 0, timestamp_precision::milliseconds, "1970-01-02T00:00:00.000Z") ||
+         expect(c, 1401626096, 789012345, timestamp_precision::microseconds,
+                "2014-06-01T12:34:56.789012Z") ||
+         c.format(small, sizeof(small), timestamp_precision::milliseconds) == 0 ||
+         c.format(small, sizeof(small), timestamp_precision::microseconds) != 0 ||
+         log.timestamp().size() != 24;
+}
@@ -0,0 +1,82 @@
+#include <qlog/uring_sink.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Returns the contents of the file @p path.
+ */
+static std::string contents(char const* path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+/**
+ * @brief Fails unless @p text holds the records from @p first up to @p last in order, each on its
+ *        own line after the severity.
+ */
+static int expect_records(char const* what, std::string const& text, int first, int last) {
+  std::istringstream lines(text);
+  std::string line;
+  int next = first;
+  while(std::getline(lines, line)) {
+    std::ostringstream expected;
+    expected << "[INFO] record " << next << " of a line padded out to some length";
+    if(line.find(expected.str()) == std::string::npos) {
+      std::cerr << what << ": expected record " << next << " but got " << line << std::endl;
+      return 1;
+    }
+    ++next;
+  }
+  if(next != last) {
+    std::cerr << what << ": expected " << last - first << " records but got " << next - first
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes records @p first up to @p last through an asynchronous log.
+ */
+static int write_records(char const* what, char const* path, int first, int last,
+                         unsigned buffers, std::size_t buffer_size,
+                         std::chrono::milliseconds sync) {
+  qlog::uring_sink file(path, buffers, buffer_size, sync);
+  if(!file.is_open()) {
+    std::cerr << what << ": could not open " << path << std::endl;
+    return 1;
+  }
+  {
+    qlog::logger log(file, qlog::info, 64);
+    for(int i = first; i < last; ++i) {
+      log(qlog::info) << "record " << i << " of a line padded out to some length";
+    }
+  }
+  file.wait();
+  if(file.errors()) {
+    std::cerr << what << ": " << file.errors() << " writes failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  char const* const path = "uring_test.log";
+  std::remove(path);
+  // Small buffers keep every buffer busy, so the log has to wait for completions, and records
+  // are split across buffers.
+  if(write_records("small", path, 0, 5000, 2, 100, std::chrono::milliseconds(0)) ||
+     expect_records("small", contents(path), 0, 5000)) {
+    return 1;
+  }
+  // A second sink appends to the file, and syncs it on every flush.
+  if(write_records("append", path, 5000, 6000, 8, 4096, std::chrono::milliseconds(1)) ||
+     expect_records("append", contents(path), 0, 6000)) {
+    return 1;
+  }
+  std::remove(path);
+  return 0;
+}
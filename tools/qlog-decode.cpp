@@ -0,0 +1,40 @@
+#include <qlog/binary.hpp>
+#include <cstring>
+#include <fstream>
+
+/**
+ * @brief Converts a binary log written by qlog::binary_logger into text.
+ *
+ *     qlog-decode [-u | -n] [file]
+ *
+ * Reads @c file, or standard input when it is omitted, and writes one line per record to
+ * standard output. @c -u and @c -n select microsecond and nanosecond timestamps.
+ */
+int main(int argc, char** argv) {
+  qlog::timestamp_precision p = qlog::timestamp_precision::milliseconds;
+  int i = 1;
+  for(; i < argc && argv[i][0] == '-'; ++i) {
+    if(std::strcmp(argv[i], "-u") == 0) {
+      p = qlog::timestamp_precision::microseconds;
+    } else if(std::strcmp(argv[i], "-n") == 0) {
+      p = qlog::timestamp_precision::nanoseconds;
+    } else {
+      std::cerr << "usage: " << argv[0] << " [-u | -n] [file]" << std::endl;
+      return 2;
+    }
+  }
+
+  std::ifstream file;
+  if(i < argc) {
+    file.open(argv[i], std::ios::binary);
+    if(!file) {
+      std::cerr << argv[0] << ": cannot open " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+  if(!qlog::decode(i < argc ? file : std::cin, std::cout, p)) {
+    std::cerr << argv[0] << ": not a qlog binary stream, or it is damaged" << std::endl;
+    return 1;
+  }
+  return 0;
+}